@@ -0,0 +1,45 @@
+#pragma once
+#include <Block/BlockControls.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace Jit
+{
+/**
+ * @brief Planar channels, each aligned on blockAlignment bytes.
+ *
+ * Memory is only allocated when growing: the node reserves the usual
+ * size when created, so that the audio thread does not allocate.
+ */
+template <typename T>
+class aligned_channels
+{
+public:
+  void resize(int channels, int frames)
+  {
+    static constexpr int line = blockAlignment / sizeof(T);
+    const int stride = (frames + line - 1) / line * line;
+
+    const std::size_t needed = std::size_t(channels) * stride + line;
+    if (m_storage.size() < needed)
+      m_storage.resize(needed);
+
+    void* base = m_storage.data();
+    std::size_t space = m_storage.size() * sizeof(T);
+    auto data = static_cast<T*>(std::align(
+        blockAlignment, (needed - line) * sizeof(T), base, space));
+
+    m_channels.resize(channels);
+    for (int c = 0; c < channels; c++)
+      m_channels[c] = data + c * stride;
+  }
+
+  T* const* data() const noexcept { return m_channels.data(); }
+  T* operator[](int c) const noexcept { return m_channels[c]; }
+
+private:
+  std::vector<T> m_storage;
+  std::vector<T*> m_channels;
+};
+}
@@ -0,0 +1,592 @@
+
+#include "Block.hpp"
+
+#include <QPointer>
+
+#include <Block/AlignedChannels.hpp>
+#include <Block/BlockFusion.hpp>
+#include <JitCpp/Compiler/Driver.hpp>
+#include <JitCpp/EditScript.hpp>
+#include <JitCpp/ExecutionContext.hpp>
+#include <JitCpp/Profiler.hpp>
+#include <JitCpp/RealtimeArena.hpp>
+#include <JitCpp/SampleConversion.hpp>
+#include <JitCpp/WarmUp.hpp>
+
+#include <Process/Dataflow/Port.hpp>
+#include <Process/Dataflow/PortFactory.hpp>
+
+#include <score/command/Dispatchers/CommandDispatcher.hpp>
+#include <score/tools/IdentifierGeneration.hpp>
+
+#include <ossia/dataflow/execution_state.hpp>
+#include <ossia/dataflow/port.hpp>
+
+#include <algorithm>
+#include <memory>
+
+#include <wobjectimpl.h>
+
+W_OBJECT_IMPL(Jit::BlockModel)
+namespace Jit
+{
+//! The #line keeps the line numbers of the diagnostics the ones of the script
+QString generateBlockFunction(const QString& script)
+{
+  return blockPrelude() + "#line 1\n" + script + "\n";
+}
+
+BlockModel::BlockModel(
+    TimeVal t,
+    const QString& jitProgram,
+    const Id<Process::ProcessModel>& id,
+    QObject* parent)
+    : Process::ProcessModel{t, id, "Jit", parent}
+{
+  auto audio_in = new Process::AudioInlet{Id<Process::Port>{0}, this};
+  this->m_inlets.push_back(audio_in);
+  setControls(defaultBlockControls());
+
+  auto audio_out = new Process::AudioOutlet{Id<Process::Port>{0}, this};
+  audio_out->setPropagate(true);
+  this->m_outlets.push_back(audio_out);
+  init();
+  if(jitProgram.isEmpty())
+    setScript(Process::EffectProcessFactory_T<Jit::BlockModel>{}.customConstructionData());
+  else
+    setScript(jitProgram);
+}
+
+BlockModel::~BlockModel() {}
+
+BlockModel::BlockModel(JSONObject::Deserializer& vis, QObject* parent)
+    : Process::ProcessModel{vis, parent}
+{
+  vis.writeTo(*this);
+  init();
+}
+
+BlockModel::BlockModel(DataStream::Deserializer& vis, QObject* parent)
+    : Process::ProcessModel{vis, parent}
+{
+  vis.writeTo(*this);
+  init();
+}
+
+BlockModel::BlockModel(JSONObject::Deserializer&& vis, QObject* parent)
+    : Process::ProcessModel{vis, parent}
+{
+  vis.writeTo(*this);
+  init();
+}
+
+BlockModel::BlockModel(DataStream::Deserializer&& vis, QObject* parent)
+    : Process::ProcessModel{vis, parent}
+{
+  vis.writeTo(*this);
+  init();
+}
+
+void BlockModel::setScript(const QString& txt)
+{
+  if(m_text != txt)
+  {
+    m_text = txt;
+    reloadAsync(CompilePriority::Editor);
+    scriptChanged(txt);
+  }
+}
+
+void BlockModel::init()
+{
+  // Recompile for the new buffer size and sample rate
+  ExecutionContext::onChanged(
+      this, [this] { reloadAsync(CompilePriority::Playing); });
+}
+
+QString BlockModel::prettyName() const noexcept
+{
+  return "Block";
+}
+
+void BlockModel::reload()
+{
+  m_builds.run(compileJob());
+}
+
+void BlockModel::reloadAsync(CompilePriority prio)
+{
+  m_builds.submit(prio, compileJob());
+}
+
+/**
+ * @brief Runs a new block function once on silence, on the compile thread.
+ *
+ * Lazy statics and the first page and cache misses then happen here
+ * rather than in the first buffer of the audio thread.
+ */
+template <typename T, typename F>
+static void dryRun(
+    F* fun,
+    const std::vector<BlockControl>& decls,
+    const ExecutionContext& context)
+{
+  const int N = context.bufferSize;
+  aligned_channels<T> in, out;
+  in.resize(2, N);
+  out.resize(2, N);
+  for (int c = 0; c < 2; c++)
+    std::fill(in[c], in[c] + N, T{});
+
+  const block_controls controls{decls};
+  const auto params = controls.params(context.sampleRate, 0);
+  fun(in.data(), out.data(), 2, N, &params);
+}
+
+CompileScheduler::Work BlockModel::compileJob()
+{
+  auto fx_text = Jit::generateBlockFunction(m_text).toLocal8Bit().toStdString();
+  QPointer<BlockModel> self = this;
+  const void* owner = this;
+  auto name = metadata().getName();
+  auto context = ExecutionContext::current();
+  auto flags = context.flags();
+  return [self, owner, name, fx_text, flags, context](
+             const CancellationToken& cancelled)
+             -> CompileScheduler::Completion {
+    if (fx_text.empty())
+      return {};
+
+    auto compiler = makeDriver<BlockCompiler>(
+        "score_block_process", name, owner, RealtimeArena::defaultSize());
+    BlockFactory jit_factory;
+    BlockFactory64 jit_factory64;
+    std::vector<BlockControl> controls;
+    bool fusible{};
+    CompilerOptions opts{true};
+    opts.OptimizationRemarks = true;
+
+    try
+    {
+      jit_factory = (*compiler)(fx_text, flags, opts, cancelled);
+
+      if (!jit_factory)
+        return {};
+
+      // Scripts working on double declare it with SCORE_BLOCK_SAMPLE_TYPE
+      auto bits = compiler->symbol<const int>("score_block_sample_bits");
+      if (bits && *bits == 64)
+      {
+        jit_factory64 = compiler->symbol<BlockFunction64>("score_block_process");
+        jit_factory = {};
+      }
+      else if (bits && *bits != 32)
+      {
+        return reportError(self, "Samples can only be float or double");
+      }
+
+      auto declared = declaredControls(
+          compiler->symbol<const int>("score_block_control_count"),
+          compiler->symbol<const BlockControlDeclaration>(
+              "score_block_controls"));
+      if (!declared)
+      {
+        return reportError(self, "Unknown control type");
+      }
+      controls = std::move(*declared);
+
+      // Fused stages are called on tiles rather than on whole buffers:
+      // only scripts which accept it are fused
+      fusible = jit_factory
+                && compiler->symbol<const int>("score_block_fusion");
+
+      if (dryRunEnabled())
+      {
+        ScopedArena arena{compiler->arena()};
+        if (auto f = jit_factory.target<BlockFunction*>())
+          dryRun<float>(*f, controls, context);
+        else if (auto f = jit_factory64.target<BlockFunction64*>())
+          dryRun<double>(*f, controls, context);
+      }
+    }
+    catch (const std::exception& e)
+    {
+      return reportError(self, QString{e.what()});
+    }
+    catch (...)
+    {
+      return reportError(self, "JIT error");
+    }
+
+    auto remarks = remarksMessage(compiler->remarks());
+    return [self, compiler, jit_factory, jit_factory64, controls, fusible,
+            remarks] {
+      if (self)
+      {
+        self->setFactory(
+            compiler, jit_factory, jit_factory64, controls, fusible);
+        if (!remarks.second.empty())
+          self->errorMessage(
+              remarks.first, QString::fromStdString(remarks.second));
+      }
+    };
+  };
+}
+
+void BlockModel::setFactory(
+    std::shared_ptr<BlockCompiler> compiler,
+    BlockFactory jit_factory,
+    BlockFactory64 jit_factory64,
+    std::vector<BlockControl> controls,
+    bool fusible)
+{
+  m_builds.setCurrent(std::move(compiler));
+
+  factory = std::move(jit_factory);
+  factory64 = std::move(jit_factory64);
+  arena = m_builds.current()->arena();
+  this->fusible = fusible;
+  setControls(std::move(controls));
+  changed();
+}
+
+void BlockModel::setControls(std::vector<BlockControl> controls)
+{
+  if (updateControlInlets(*this, m_inlets, m_controls, std::move(controls)))
+    inletsChanged();
+}
+
+class block_node final
+    : public ossia::nonowning_graph_node
+{
+public:
+  block_node(const std::vector<BlockControl>& decls, int bufferSize)
+      : controls{decls}
+  {
+    m_inlets.push_back(&audio_in);
+    for (auto& port : controls.ports())
+      m_inlets.push_back(&port);
+    m_outlets.push_back(&audio_out);
+
+    // Both, as the sample type can change with the script
+    in32.resize(2, bufferSize);
+    out32.resize(2, bufferSize);
+    in64.resize(2, bufferSize);
+    out64.resize(2, bufferSize);
+  }
+
+  void set_function(
+      BlockFunction* func,
+      BlockFunction64* func64,
+      RealtimeArena* arena)
+  {
+    this->func = func;
+    this->func64 = func64;
+    this->arena = arena;
+  }
+
+  void set_fusion(std::shared_ptr<BlockFusionState> fusion, int stage)
+  {
+    this->fusion = std::move(fusion);
+    this->stage = stage;
+  }
+
+  void run(const ossia::token_request& t, ossia::exec_state_facade f) noexcept override
+  {
+    controls.update();
+
+    if (fusion && runFused(f))
+      return;
+
+    if (func)
+      process(func, in32, out32, f);
+    else if (func64)
+      process(func64, in64, out64, f);
+  }
+
+  long long time = 0;
+  BlockFunction* func = nullptr;
+  BlockFunction64* func64 = nullptr;
+  RealtimeArena* arena = nullptr;
+  std::shared_ptr<Jit::NodeProfile> profile;
+
+  //! Set when the node is a stage of a chain, see BlockFusionState
+  std::shared_ptr<BlockFusionState> fusion;
+  int stage = -1;
+
+  aligned_channels<float> in32, out32;
+  aligned_channels<double> in64, out64;
+
+  ossia::audio_inlet audio_in;
+  block_controls controls;
+  ossia::audio_outlet audio_out;
+
+private:
+  //! The graph works on double: convert once on each side
+  template <typename T>
+  void readInput(aligned_channels<T>& in, int channels, int N) noexcept
+  {
+    const ossia::audio_port& ip = *audio_in;
+    in.resize(channels, N);
+    for (int c = 0; c < channels; c++)
+    {
+      T* dst = in[c];
+      int n = 0;
+      if (c < int(ip.samples.size()))
+      {
+        const auto& src = ip.samples[c];
+        n = std::min(N, int(src.size()));
+        convertSamples(src.data(), dst, n);
+      }
+      std::fill(dst + n, dst + N, T{});
+    }
+  }
+
+  template <typename T>
+  void writeOutput(const aligned_channels<T>& out, int channels, int N) noexcept
+  {
+    ossia::audio_port& op = *audio_out;
+    op.samples.resize(channels);
+    for (int c = 0; c < channels; c++)
+    {
+      op.samples[c].resize(N);
+      convertSamples(out[c], op.samples[c].data(), N);
+    }
+  }
+
+  template <typename T, typename F>
+  void process(
+      F* fun,
+      aligned_channels<T>& in,
+      aligned_channels<T>& out,
+      ossia::exec_state_facade f) noexcept
+  {
+    const int N = f.bufferSize();
+    const int channels = std::max(2, int(audio_in->samples.size()));
+
+    readInput(in, channels, N);
+    out.resize(channels, N);
+
+    const auto params = controls.params(f.sampleRate(), time);
+    {
+      Jit::ScopedProfile p{profile.get(), N, f.sampleRate()};
+      Jit::ScopedArena a{arena};
+      fun(in.data(), out.data(), channels, N, &params);
+    }
+    time += N;
+
+    writeOutput(out, channels, N);
+  }
+
+  //! False when the chain has no build yet and the node runs on its own
+  bool runFused(ossia::exec_state_facade f) noexcept
+  {
+    auto& s = *fusion;
+    const int N = f.bufferSize();
+    const int last = int(s.stages.size()) - 1;
+
+    if (stage == 0)
+    {
+      // Until every stage has its node, each one runs its own function
+      s.active = s.build.load(std::memory_order_acquire);
+      for (const auto& st : s.stages)
+        if (st.expired())
+          s.active = nullptr;
+      if (!s.active)
+        return false;
+
+      s.channels = std::min(
+          fusedMaxChannels, std::max(2, int(audio_in->samples.size())));
+      readInput(s.in, s.channels, N);
+    }
+    else if (!s.active)
+    {
+      return false;
+    }
+
+    time += N;
+    if (stage != last)
+      return true;
+
+    for (int i = 0; i <= last; i++)
+    {
+      if (auto ctl = s.stages[i].lock())
+        s.params[i] = ctl->params(f.sampleRate(), time - N);
+    }
+
+    out32.resize(s.channels, N);
+    {
+      Jit::ScopedProfile p{profile.get(), N, f.sampleRate()};
+      Jit::ScopedArena a{s.active->arena};
+      s.active->function(
+          s.in.data(), out32.data(), s.channels, N, s.paramPointers.data());
+    }
+    writeOutput(out32, s.channels, N);
+
+    // Latched again by the first stage on the next tick
+    s.active = nullptr;
+    return true;
+  }
+};
+
+template <typename F>
+static F* blockFunction(const std::function<F>& f)
+{
+  auto tgt = f.template target<F*>();
+  return tgt ? *tgt : nullptr;
+}
+
+BlockExecutor::BlockExecutor(
+    Jit::BlockModel& proc,
+    const Execution::Context& ctx,
+    const Id<score::Component>& id,
+    QObject* parent)
+    : ScriptExecutor{proc, ctx, id, "JitComponent", parent}
+{
+  reset();
+
+  con(proc, &Jit::BlockModel::changed,
+      this, [this, &proc] {
+        // New controls need a new node, otherwise only the code changes ;
+        // so does a new chain, as the script may have opted out of fusion
+        const auto chain = blockFusionEnabled()
+                               ? blockChain(proc, system().doc)
+                               : std::vector<BlockModel*>{};
+        if (proc.controls() != m_controls || chain != m_chain)
+        {
+          reset();
+          return;
+        }
+
+        auto bb = static_cast<block_node*>(node.get());
+        auto f32 = blockFunction(proc.factory);
+        auto f64 = blockFunction(proc.factory64);
+        if(f32 || f64)
+        {
+          in_exec([f32, f64, bb, arena = proc.arena] {
+            bb->set_function(f32, f64, arena);
+          });
+        }
+  });
+}
+
+void BlockExecutor::reset()
+{
+  auto& proc = process();
+  m_controls = proc.controls();
+
+  auto bb = new block_node{m_controls, ExecutionContext::current().bufferSize};
+  bb->profile = Jit::Profiler::instance().create(&proc, proc.metadata().getName());
+  bb->set_function(
+      blockFunction(proc.factory), blockFunction(proc.factory64), proc.arena);
+  setNode(std::shared_ptr<ossia::graph_node>(bb));
+
+  // After the swap, so that the stages are the nodes of the graph
+  setupFusion();
+}
+
+void BlockExecutor::setupFusion()
+{
+  auto& proc = process();
+  m_chain = blockFusionEnabled() ? blockChain(proc, system().doc)
+                                 : std::vector<BlockModel*>{};
+  m_fusion.reset();
+  if (m_chain.empty())
+    return;
+
+  m_fusion = BlockFusion::get(m_chain);
+  const int stage = m_fusion->stage(&proc);
+  auto state = m_fusion->state();
+
+  // The node may already be in the graph, as may the other stages
+  auto bb = static_cast<block_node*>(node.get());
+  in_exec([bb, state, stage,
+           controls = std::shared_ptr<const block_controls>(node, &bb->controls)] {
+    bb->set_fusion(state, stage);
+    state->stages[stage] = controls;
+  });
+}
+
+BlockExecutor::~BlockExecutor() {}
+
+}
+
+template <>
+void DataStreamReader::read(const Jit::BlockModel& eff)
+{
+  m_stream << eff.m_text;
+  readPorts(*this, eff.m_inlets, eff.m_outlets);
+}
+
+template <>
+void DataStreamWriter::write(Jit::BlockModel& eff)
+{
+  m_stream >> eff.m_text;
+  writePorts(
+      *this,
+      components.interfaces<Process::PortFactoryList>(),
+      eff.m_inlets,
+      eff.m_outlets,
+      &eff);
+  eff.reload();
+}
+
+template <>
+void JSONReader::read(const Jit::BlockModel& eff)
+{
+  obj["Text"] = eff.script();
+  readPorts(*this, eff.m_inlets, eff.m_outlets);
+}
+
+template <>
+void JSONWriter::write(Jit::BlockModel& eff)
+{
+  eff.m_text = obj["Text"].toString();
+  writePorts(
+      *this,
+      components.interfaces<Process::PortFactoryList>(),
+      eff.m_inlets,
+      eff.m_outlets,
+      &eff);
+  eff.reload();
+}
+
+namespace Process
+{
+
+template <>
+QString
+EffectProcessFactory_T<Jit::BlockModel>::customConstructionData() const
+{
+  return R"_(// One inlet per control ; p->controls has the float ones,
+// p->bool_controls the bool ones, etc.
+SCORE_BLOCK_CONTROLS(
+  {"Gain", SCORE_CONTROL_FLOAT, 0.f, 1.f, 0.5f},
+  {"Mute", SCORE_CONTROL_BOOL, 0.f, 1.f, 0.f}
+);
+
+// in[c] and out[c] are aligned on SCORE_BLOCK_ALIGNMENT bytes
+extern "C" void score_block_process(
+    const float* const* in, float* const* out,
+    int channels, int frames, const score_block_params* p)
+{
+  const float gain = p->bool_controls[0] ? 0.f : p->controls[0];
+  for(int c = 0; c < channels; c++)
+  {
+    const float* i = SCORE_BLOCK_ASSUME_ALIGNED(in[c]);
+    float* o = SCORE_BLOCK_ASSUME_ALIGNED(out[c]);
+    for(int f = 0; f < frames; f++)
+      o[f] = gain * i[f];
+  }
+}
+)_";
+}
+
+template <>
+Process::Descriptor
+EffectProcessFactory_T<Jit::BlockModel>::descriptor(QString d) const
+{
+  return Metadata<Descriptor_k, Jit::BlockModel>::get();
+}
+
+}
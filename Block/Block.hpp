@@ -0,0 +1,203 @@
+#pragma once
+#include <Process/Execution/ProcessComponent.hpp>
+#include <Process/GenericProcessFactory.hpp>
+#include <Process/Process.hpp>
+#include <Process/ProcessMetadata.hpp>
+
+#include <ossia/dataflow/execution_state.hpp>
+#include <ossia/dataflow/graph_node.hpp>
+#include <ossia/dataflow/node_process.hpp>
+
+#include <Process/Script/ScriptEditor.hpp>
+#include <Block/BlockControls.hpp>
+#include <JitCpp/EditScript.hpp>
+#include <JitCpp/CompileScheduler.hpp>
+#include <JitCpp/ScriptBuilds.hpp>
+#include <JitCpp/ScriptExecutor.hpp>
+
+#include <Control/DefaultEffectItem.hpp>
+#include <Effect/EffectFactory.hpp>
+#include <verdigris>
+
+namespace Jit
+{
+class BlockModel;
+}
+PROCESS_METADATA(
+    ,
+    Jit::BlockModel,
+    "9f4404d6-5e34-41dc-9f25-294920cac80a",
+    "Jit",
+    "C++ block effect",
+    Process::ProcessCategory::Script,
+    "Script",
+    "Run a C function over blocks of audio",
+    "ossia score",
+    QStringList{},
+    {},
+    {},
+    Process::ProcessFlags::SupportsAll)
+namespace Jit
+{
+template <typename Fun_T>
+struct Driver;
+class RealtimeArena;
+
+/**
+ * @brief Plain C entry point of a block process.
+ *
+ * The scripts are given the declarations they need, without any ossia
+ * header, and every channel is a buffer aligned on blockAlignment bytes.
+ * Samples are float unless the script declares SCORE_BLOCK_SAMPLE_TYPE(double),
+ * in which case BlockFunction64 is used.
+ */
+using BlockFunction = void(
+    const float* const* in,
+    float* const* out,
+    int channels,
+    int frames,
+    const BlockParams* params);
+using BlockFunction64 = void(
+    const double* const* in,
+    double* const* out,
+    int channels,
+    int frames,
+    const BlockParams* params);
+using BlockCompiler = Driver<BlockFunction>;
+using BlockFactory = std::function<BlockFunction>;
+using BlockFactory64 = std::function<BlockFunction64>;
+
+class BlockModel : public Process::ProcessModel
+{
+  friend class JitUI;
+  friend class JitUpdateUI;
+  SCORE_SERIALIZE_FRIENDS
+  PROCESS_METADATA_IMPL(BlockModel)
+
+  W_OBJECT(BlockModel)
+public:
+  BlockModel(
+      TimeVal t,
+      const QString& jitProgram,
+      const Id<Process::ProcessModel>&,
+      QObject* parent);
+  ~BlockModel() override;
+
+  BlockModel(DataStream::Deserializer& vis, QObject* parent);
+  BlockModel(JSONObject::Deserializer& vis, QObject* parent);
+  BlockModel(DataStream::Deserializer&& vis, QObject* parent);
+  BlockModel(JSONObject::Deserializer&& vis, QObject* parent);
+
+  const QString& script() const noexcept { return m_text; }
+  void setScript(const QString& txt);
+  void scriptChanged(const QString& txt) W_SIGNAL(scriptChanged, txt);
+
+  static constexpr bool hasExternalUI() noexcept { return true; }
+
+  QString prettyName() const noexcept override;
+  void changed() W_SIGNAL(changed);
+
+  Process::Inlets& inlets() { return m_inlets; }
+  Process::Outlets& outlets() { return m_outlets; }
+
+  //! Declared by the script with SCORE_BLOCK_CONTROLS, one inlet each
+  const std::vector<BlockControl>& controls() const noexcept
+  {
+    return m_controls;
+  }
+
+  //! Only one of them is set, depending on the sample type of the script
+  BlockFactory factory;
+  BlockFactory64 factory64;
+
+  //! Where the allocations of the factories go, may be nullptr
+  RealtimeArena* arena{};
+
+  //! A float effect which opted in with SCORE_BLOCK_FUSION
+  bool fusible{};
+
+  void errorMessage(int line, const QString& e) W_SIGNAL(errorMessage, line, e);
+
+  PROPERTY(QString, script READ script WRITE setScript NOTIFY scriptChanged)
+private:
+  void init();
+
+  //! Compiles synchronously, used when loading
+  void reload();
+
+  //! Compiles in the background, the result is applied once ready
+  void reloadAsync(CompilePriority prio);
+  CompileScheduler::Work compileJob();
+  void setFactory(
+      std::shared_ptr<BlockCompiler> compiler,
+      BlockFactory factory,
+      BlockFactory64 factory64,
+      std::vector<BlockControl> controls,
+      bool fusible);
+
+  //! Recreates the control inlets if the declarations changed
+  void setControls(std::vector<BlockControl> controls);
+
+  QString m_text;
+  std::vector<BlockControl> m_controls;
+  ScriptBuilds<BlockCompiler> m_builds{"block", this};
+};
+}
+
+namespace Process
+{
+template <>
+QString
+EffectProcessFactory_T<Jit::BlockModel>::customConstructionData() const;
+
+template <>
+Process::Descriptor
+EffectProcessFactory_T<Jit::BlockModel>::descriptor(QString d) const;
+}
+class QPlainTextEdit;
+namespace Jit
+{
+
+struct BlockLanguageSpec
+{
+  static constexpr const char* language = "C++";
+};
+
+using BlockEffectFactory = Process::EffectProcessFactory_T<BlockModel>;
+using BlockLayerFactory = Process::EffectLayerFactory_T<
+    BlockModel,
+    Process::DefaultEffectItem,
+    Process::ProcessScriptEditDialog<BlockModel, BlockModel::p_script, BlockLanguageSpec>
+>;
+
+class BlockFusion;
+class BlockExecutor final : public ScriptExecutor<Jit::BlockModel>
+{
+  COMPONENT_METADATA("4bf3e88b-606f-4755-98d8-aeaa1ffb4a44")
+
+public:
+  static constexpr bool is_unique = true;
+
+  BlockExecutor(
+      Jit::BlockModel& proc,
+      const Execution::Context& ctx,
+      const Id<score::Component>& id,
+      QObject* parent);
+  ~BlockExecutor() override;
+
+private:
+  void reset();
+
+  //! Joins the chain of effects proc is part of, if any
+  void setupFusion();
+
+  std::vector<BlockControl> m_controls;
+  std::vector<BlockModel*> m_chain;
+  std::shared_ptr<BlockFusion> m_fusion;
+};
+using BlockExecutorFactory
+    = Execution::ProcessComponentFactory_T<BlockExecutor>;
+}
+
+PROPERTY_COMMAND_T(Jit, EditBlock, BlockModel::p_script, "Edit block effect")
+SCORE_COMMAND_DECL_T(Jit::EditBlock)
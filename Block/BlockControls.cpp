@@ -0,0 +1,232 @@
+#include "BlockControls.hpp"
+
+#include <ossia/network/value/value_conversion.hpp>
+
+#include <algorithm>
+
+namespace Jit
+{
+QString blockPrelude()
+{
+  return QString(R"_(
+struct score_block_params
+{
+  double sample_rate;
+  long long time;
+  const float* controls;
+  int control_count;
+  const int* int_controls;
+  int int_control_count;
+  const bool* bool_controls;
+  int bool_control_count;
+  const float* vec3_controls;
+  int vec3_control_count;
+};
+enum score_block_control_type
+{
+  SCORE_CONTROL_FLOAT,
+  SCORE_CONTROL_INT,
+  SCORE_CONTROL_BOOL,
+  SCORE_CONTROL_VEC3
+};
+struct score_block_control
+{
+  const char* name;
+  int type;
+  float min, max, init;
+};
+#define SCORE_BLOCK_CONTROLS(...) \
+  extern "C" const score_block_control score_block_controls[] = {__VA_ARGS__}; \
+  extern "C" const int score_block_control_count \
+      = sizeof(score_block_controls) / sizeof(score_block_control)
+#define SCORE_BLOCK_ALIGNMENT %1
+#define SCORE_BLOCK_ASSUME_ALIGNED(p) \
+  ((__typeof__(p))__builtin_assume_aligned((p), SCORE_BLOCK_ALIGNMENT))
+#define SCORE_BLOCK_SAMPLE_TYPE(T) \
+  extern "C" const int score_block_sample_bits = 8 * sizeof(T)
+#define SCORE_BLOCK_FUSION \
+  extern "C" const int score_block_fusion = 1
+)_").arg(blockAlignment);
+}
+
+std::vector<BlockControl> defaultBlockControls()
+{
+  std::vector<BlockControl> controls;
+  for (int i = 0; i < 4; i++)
+    controls.push_back(
+        {QString("Control %1").arg(i + 1), BlockControlType::Float, 0.f, 1.f, 0.5f});
+  return controls;
+}
+
+std::optional<std::vector<BlockControl>> declaredControls(
+    const int* count,
+    const BlockControlDeclaration* decls)
+{
+  if (!count || !decls)
+    return defaultBlockControls();
+
+  std::vector<BlockControl> controls;
+  for (int i = 0; i < *count; i++)
+  {
+    const auto& d = decls[i];
+    if (d.type < int(BlockControlType::Float) || d.type > int(BlockControlType::Vec3))
+      return std::nullopt;
+    controls.push_back(
+        {QString::fromUtf8(d.name), BlockControlType(d.type), d.min, d.max, d.init});
+  }
+  return controls;
+}
+
+static State::Domain controlDomain(const BlockControl& c)
+{
+  switch (c.type)
+  {
+    case BlockControlType::Int:
+      return State::Domain{ossia::make_domain(int(c.min), int(c.max))};
+    case BlockControlType::Bool:
+      return State::Domain{ossia::make_domain(false, true)};
+    case BlockControlType::Vec3:
+      return State::Domain{ossia::make_domain(
+          ossia::vec3f{c.min, c.min, c.min}, ossia::vec3f{c.max, c.max, c.max})};
+    default:
+      return State::Domain{ossia::make_domain(c.min, c.max)};
+  }
+}
+
+static ossia::value controlValue(const BlockControl& c)
+{
+  switch (c.type)
+  {
+    case BlockControlType::Int:
+      return int(c.init);
+    case BlockControlType::Bool:
+      return c.init != 0.f;
+    case BlockControlType::Vec3:
+      return ossia::vec3f{c.init, c.init, c.init};
+    default:
+      return c.init;
+  }
+}
+
+bool updateControlInlets(
+    Process::ProcessModel& self,
+    Process::Inlets& inlets,
+    std::vector<BlockControl>& current,
+    std::vector<BlockControl> controls)
+{
+  // Keeps the inlets, their values and cables when only the code changed
+  if (controls == current)
+    return false;
+
+  // Inlets restored from a saved document, before the first build
+  if (current.empty() && inlets.size() == controls.size() + 1)
+  {
+    bool same = true;
+    for (std::size_t i = 0; i < controls.size(); i++)
+      same &= inlets[i + 1]->customData() == controls[i].name;
+    if (same)
+    {
+      current = std::move(controls);
+      return false;
+    }
+  }
+  current = std::move(controls);
+
+  for (std::size_t i = 1; i < inlets.size(); i++)
+    delete inlets[i];
+  inlets.resize(1);
+
+  for (std::size_t i = 0; i < current.size(); i++)
+  {
+    const auto& c = current[i];
+    auto ctl = new Process::ControlInlet{Id<Process::Port>{int(i) + 1}, &self};
+    ctl->setCustomData(c.name);
+    ctl->setDomain(controlDomain(c));
+    ctl->setValue(controlValue(c));
+    inlets.push_back(ctl);
+  }
+  return true;
+}
+
+block_controls::block_controls(const std::vector<BlockControl>& decls)
+{
+  // Each control gets its slot in the array of its type
+  for (const auto& c : decls)
+  {
+    m_ports.emplace_back();
+    auto& s = m_slots.emplace_back();
+    s.type = c.type;
+    switch (c.type)
+    {
+      case BlockControlType::Float:
+        s.index = m_floats.size();
+        m_floats.push_back(c.init);
+        break;
+      case BlockControlType::Int:
+        s.index = m_ints.size();
+        m_ints.push_back(int(c.init));
+        break;
+      case BlockControlType::Bool:
+        s.index = m_bool_count++;
+        break;
+      case BlockControlType::Vec3:
+        s.index = m_vec3s.size() / 3;
+        m_vec3s.insert(m_vec3s.end(), {c.init, c.init, c.init});
+        break;
+    }
+  }
+
+  m_bools = std::make_unique<bool[]>(std::max(1, m_bool_count));
+  for (std::size_t i = 0; i < decls.size(); i++)
+    if (decls[i].type == BlockControlType::Bool)
+      m_bools[m_slots[i].index] = decls[i].init != 0.f;
+}
+
+void block_controls::update() noexcept
+{
+  // Only the last value of a tick matters: it is converted once here
+  for (std::size_t i = 0; i < m_slots.size(); i++)
+  {
+    auto& data = m_ports[i].data.get_data();
+    if (data.empty())
+      continue;
+
+    const auto& v = data.back().value;
+    const auto& s = m_slots[i];
+    switch (s.type)
+    {
+      case BlockControlType::Float:
+        m_floats[s.index] = ossia::convert<float>(v);
+        break;
+      case BlockControlType::Int:
+        m_ints[s.index] = ossia::convert<int>(v);
+        break;
+      case BlockControlType::Bool:
+        m_bools[s.index] = ossia::convert<bool>(v);
+        break;
+      case BlockControlType::Vec3:
+      {
+        const auto vec = ossia::convert<ossia::vec3f>(v);
+        std::copy_n(vec.begin(), 3, m_vec3s.begin() + 3 * s.index);
+        break;
+      }
+    }
+  }
+}
+
+BlockParams
+block_controls::params(double sampleRate, long long time) const noexcept
+{
+  return {
+      sampleRate,
+      time,
+      m_floats.data(),
+      int(m_floats.size()),
+      m_ints.data(),
+      int(m_ints.size()),
+      m_bools.get(),
+      m_bool_count,
+      m_vec3s.data(),
+      int(m_vec3s.size() / 3)};
+}
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <Process/Dataflow/Port.hpp>
+#include <Process/Process.hpp>
+
+#include <ossia/dataflow/port.hpp>
+
+#include <QString>
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace Jit
+{
+/**
+ * @brief Parameters of a block function, see blockPrelude.
+ *
+ * Has to stay identical to the struct given to the scripts. The controls
+ * are unboxed by the node, in one contiguous array per type and in
+ * declaration order: scripts never see an ossia::value.
+ */
+struct BlockParams
+{
+  double sample_rate;
+  long long time;
+  const float* controls;
+  int control_count;
+  const int* int_controls;
+  int int_control_count;
+  const bool* bool_controls;
+  int bool_control_count;
+  const float* vec3_controls; //!< x, y, z for each control
+  int vec3_control_count;
+};
+
+//! Type of a control declared by a block script
+enum class BlockControlType : int
+{
+  Float,
+  Int,
+  Bool,
+  Vec3
+};
+
+//! A control inlet of a block process
+struct BlockControl
+{
+  QString name;
+  BlockControlType type{};
+  float min{}, max{}, init{};
+
+  bool operator==(const BlockControl& other) const noexcept
+  {
+    return name == other.name && type == other.type && min == other.min
+           && max == other.max && init == other.init;
+  }
+  bool operator!=(const BlockControl& other) const noexcept
+  {
+    return !(*this == other);
+  }
+};
+
+//! The controls of scripts which do not declare any: four 0-1 floats
+std::vector<BlockControl> defaultBlockControls();
+
+//! Alignment of the buffers given to the block functions, in bytes
+static constexpr int blockAlignment = 64;
+
+//! Declarations common to the block and poly scripts: score_block_params,
+//! SCORE_BLOCK_CONTROLS, SCORE_BLOCK_ALIGNMENT...
+QString blockPrelude();
+
+//! Layout of the declarations of SCORE_BLOCK_CONTROLS
+struct BlockControlDeclaration
+{
+  const char* name;
+  int type;
+  float min, max, init;
+};
+
+//! From the score_block_control_count and score_block_controls symbols of a
+//! build, which may be missing ; nullopt when a type is unknown
+std::optional<std::vector<BlockControl>> declaredControls(
+    const int* count,
+    const BlockControlDeclaration* decls);
+
+/**
+ * @brief Recreates the control inlets, which follow the first inlet.
+ *
+ * Keeps the inlets, their values and cables when the declarations did not
+ * change, or when they were restored from a saved document. Returns true
+ * if the inlets were recreated.
+ */
+bool updateControlInlets(
+    Process::ProcessModel& self,
+    Process::Inlets& inlets,
+    std::vector<BlockControl>& current,
+    std::vector<BlockControl> controls);
+
+/**
+ * @brief Values of the controls of a node, one contiguous array per type.
+ *
+ * Starts from the initial values of the declarations ; update() converts the
+ * last value received by each port once per buffer.
+ */
+class block_controls
+{
+public:
+  explicit block_controls(const std::vector<BlockControl>& decls);
+
+  //! In declaration order ; a deque so that they do not move
+  std::deque<ossia::value_inlet>& ports() noexcept { return m_ports; }
+
+  void update() noexcept;
+  BlockParams params(double sampleRate, long long time) const noexcept;
+
+private:
+  struct slot
+  {
+    BlockControlType type{};
+    int index{};
+  };
+
+  std::deque<ossia::value_inlet> m_ports;
+  std::vector<slot> m_slots;
+  std::vector<float> m_floats;
+  std::vector<int> m_ints;
+  std::unique_ptr<bool[]> m_bools;
+  int m_bool_count{};
+  std::vector<float> m_vec3s;
+};
+}
@@ -0,0 +1,345 @@
+#include "BlockFusion.hpp"
+
+#include <Block/Block.hpp>
+#include <JitCpp/CompileScheduler.hpp>
+#include <JitCpp/Compiler/Driver.hpp>
+#include <JitCpp/ExecutionContext.hpp>
+#include <JitCpp/IncludeHoisting.hpp>
+#include <JitCpp/RealtimeArena.hpp>
+#include <JitCpp/WarmUp.hpp>
+
+#include <Process/Dataflow/Cable.hpp>
+#include <Process/Dataflow/Port.hpp>
+
+#include <QDebug>
+
+#include <algorithm>
+#include <map>
+
+namespace Jit
+{
+//! Frames run through every stage before the next ones ; a multiple of
+//! the alignment, so that the tiles of the buffers stay aligned
+static constexpr int fusedTile = 64;
+
+bool blockFusionEnabled() noexcept
+{
+  static const bool enabled = !qEnvironmentVariableIsSet("SCORE_JIT_NO_FUSION");
+  return enabled;
+}
+
+QString generateFusedBlockFunction(const std::vector<QString>& scripts)
+{
+  static const char* const symbols[] = {
+      "score_block_process",
+      "score_block_controls",
+      "score_block_control_count",
+      "score_block_sample_bits",
+      "score_block_fusion"};
+
+  QStringList includes;
+  QString stages;
+  for (std::size_t i = 0; i < scripts.size(); i++)
+  {
+    const auto n = QString::number(i);
+    for (auto s : symbols)
+      stages += QString("#define %1 %1_%2\n").arg(s).arg(n);
+
+    stages += "namespace score_block_stage_" + n + "\n{\n";
+    stages += hoistIncludes(scripts[i], includes);
+    stages += "\n}\n";
+
+    for (auto s : symbols)
+      stages += QString("#undef %1\n").arg(s);
+  }
+
+  QString tiles;
+  const int last = int(scripts.size()) - 1;
+  for (int i = 0; i <= last; i++)
+  {
+    tiles += QString(R"_(
+    for(int c = 0; c < channels; c++)
+    {
+      src[c] = %1;
+      dst[c] = %2;
+    }
+    p = *params[%3];
+    p.time += f0;
+    score_block_stage_%3::score_block_process_%3(src, dst, channels, n, &p);
+)_")
+                 .arg(i == 0 ? "in[c] + f0" : QString("tiles[%1][c]").arg((i - 1) % 2))
+                 .arg(i == last ? "out[c] + f0" : QString("tiles[%1][c]").arg(i % 2))
+                 .arg(i);
+  }
+
+  return blockPrelude() + includes.join('\n') + "\n" + stages + QString(R"_(
+#define SCORE_FUSED_TILE %1
+#define SCORE_FUSED_MAX_CHANNELS %2
+extern "C" void score_block_fused(
+    const float* const* in, float* const* out,
+    int channels, int frames, const score_block_params* const* params)
+{
+  alignas(SCORE_BLOCK_ALIGNMENT)
+  float tiles[2][SCORE_FUSED_MAX_CHANNELS][SCORE_FUSED_TILE];
+  const float* src[SCORE_FUSED_MAX_CHANNELS];
+  float* dst[SCORE_FUSED_MAX_CHANNELS];
+  if(channels > SCORE_FUSED_MAX_CHANNELS)
+    channels = SCORE_FUSED_MAX_CHANNELS;
+
+  for(int f0 = 0; f0 < frames; f0 += SCORE_FUSED_TILE)
+  {
+    const int n = frames - f0 < SCORE_FUSED_TILE ? frames - f0 : SCORE_FUSED_TILE;
+    score_block_params p;
+)_").arg(fusedTile).arg(fusedMaxChannels)
+         + tiles + "  }\n}\n";
+}
+
+static bool fusible(const BlockModel& proc)
+{
+  return proc.fusible && !proc.inlets().empty() && !proc.outlets().empty();
+}
+
+//! Whether the output of a stage only goes to the next one: the nodes
+//! before the last do not write their outlet
+static bool onlyToNextStage(const Process::Outlet& outlet)
+{
+  auto audio = qobject_cast<const Process::AudioOutlet*>(&outlet);
+  return audio && !audio->propagate() && outlet.cables().size() == 1;
+}
+
+//! The effect the audio outlet of proc goes to, if it is its only consumer
+static BlockModel* nextStage(BlockModel& proc, const score::DocumentContext& doc)
+{
+  try
+  {
+    auto& outlet = *proc.outlets().front();
+    if (!onlyToNextStage(outlet))
+      return nullptr;
+
+    auto& cable = outlet.cables().front().find(doc);
+    auto& sink = cable.sink().find(doc);
+    auto next = qobject_cast<BlockModel*>(sink.parent());
+    if (!next || next->parent() != proc.parent() || !fusible(*next))
+      return nullptr;
+    if (next->inlets().front() != &sink || sink.cables().size() != 1)
+      return nullptr;
+    return next;
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+}
+
+//! The effect the audio inlet of proc comes from, if it is its only cable
+//! and proc its only consumer
+static BlockModel*
+previousStage(BlockModel& proc, const score::DocumentContext& doc)
+{
+  try
+  {
+    auto& inlet = *proc.inlets().front();
+    if (inlet.cables().size() != 1)
+      return nullptr;
+
+    auto& cable = inlet.cables().front().find(doc);
+    auto& source = cable.source().find(doc);
+    auto prev = qobject_cast<BlockModel*>(source.parent());
+    if (!prev || prev->parent() != proc.parent() || !fusible(*prev))
+      return nullptr;
+    if (prev->outlets().front() != &source || !onlyToNextStage(source))
+      return nullptr;
+    return prev;
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+}
+
+std::vector<BlockModel*>
+blockChain(BlockModel& proc, const score::DocumentContext& doc)
+{
+  if (!fusible(proc))
+    return {};
+
+  // Cables cannot make a cycle in the graph, but stay on the safe side
+  BlockModel* head = &proc;
+  for (int i = 0; i < 256; i++)
+  {
+    auto prev = previousStage(*head, doc);
+    if (!prev || prev == &proc)
+      break;
+    head = prev;
+  }
+
+  std::vector<BlockModel*> chain{head};
+  while (auto next = nextStage(*chain.back(), doc))
+  {
+    if (std::find(chain.begin(), chain.end(), next) != chain.end())
+      break;
+    chain.push_back(next);
+  }
+
+  if (chain.size() < 2)
+    return {};
+  return chain;
+}
+
+BlockFusionState::BlockFusionState(int stages)
+    : stages(stages)
+    , params(stages)
+    , paramPointers(stages)
+{
+  for (int i = 0; i < stages; i++)
+    paramPointers[i] = &params[i];
+}
+
+std::shared_ptr<BlockFusion> BlockFusion::get(const std::vector<BlockModel*>& chain)
+{
+  // Keyed by the first stage ; GUI thread only
+  static std::map<const BlockModel*, std::weak_ptr<BlockFusion>> fusions;
+  for (auto it = fusions.begin(); it != fusions.end();)
+  {
+    if (it->second.expired())
+      it = fusions.erase(it);
+    else
+      ++it;
+  }
+
+  auto& entry = fusions[chain.front()];
+  if (auto existing = entry.lock())
+  {
+    bool same = existing->m_chain.size() == chain.size();
+    for (std::size_t i = 0; same && i < chain.size(); i++)
+      same = existing->m_chain[i] == chain[i];
+    if (same)
+      return existing;
+  }
+
+  auto fusion = std::make_shared<BlockFusion>(chain);
+  entry = fusion;
+  return fusion;
+}
+
+BlockFusion::BlockFusion(const std::vector<BlockModel*>& chain)
+    : m_chain(chain.begin(), chain.end())
+    , m_state{std::make_shared<BlockFusionState>(int(chain.size()))}
+{
+  m_state->in.resize(2, ExecutionContext::current().bufferSize);
+  for (auto proc : chain)
+    connect(proc, &BlockModel::changed, this, &BlockFusion::recompile);
+  recompile();
+}
+
+BlockFusion::~BlockFusion() {}
+
+int BlockFusion::stage(const BlockModel* proc) const noexcept
+{
+  for (std::size_t i = 0; i < m_chain.size(); i++)
+    if (m_chain[i] == proc)
+      return int(i);
+  return -1;
+}
+
+//! Runs a new fused function once on silence, on the compile thread
+static void dryRun(
+    FusedBlockFunction* fun,
+    const std::vector<std::vector<BlockControl>>& decls,
+    const ExecutionContext& context)
+{
+  const int N = context.bufferSize;
+  aligned_channels<float> in, out;
+  in.resize(2, N);
+  out.resize(2, N);
+  for (int c = 0; c < 2; c++)
+    std::fill(in[c], in[c] + N, 0.f);
+
+  std::vector<std::unique_ptr<block_controls>> controls;
+  std::vector<BlockParams> params;
+  std::vector<const BlockParams*> pointers;
+  for (const auto& d : decls)
+    params.push_back(
+        controls.emplace_back(std::make_unique<block_controls>(d))
+            ->params(context.sampleRate, 0));
+  for (const auto& p : params)
+    pointers.push_back(&p);
+
+  fun(in.data(), out.data(), 2, N, pointers.data());
+}
+
+void BlockFusion::recompile()
+{
+  // The current build was made for the previous scripts and controls of
+  // the stages: until the new one is published, each stage runs on its own
+  m_state->build.store(nullptr, std::memory_order_release);
+
+  std::vector<QString> scripts;
+  std::vector<std::vector<BlockControl>> controls;
+  for (const auto& proc : m_chain)
+  {
+    // A stage became a double effect or opted out: wait for the
+    // executors to rebuild the chain
+    if (!proc || !proc->fusible)
+      return;
+    scripts.push_back(proc->script());
+    controls.push_back(proc->controls());
+  }
+
+  auto fx_text = generateFusedBlockFunction(scripts).toLocal8Bit().toStdString();
+  QPointer<BlockFusion> self = this;
+  const void* owner = m_chain.front().data();
+  auto context = ExecutionContext::current();
+  auto flags = context.flags();
+  m_builds.submit(
+      CompilePriority::Playing,
+      [self, owner, fx_text, flags, context, controls](
+          const CancellationToken& cancelled) -> CompileScheduler::Completion {
+        auto compiler = makeDriver<FusedBlockCompiler>(
+            "score_block_fused",
+            QStringLiteral("Fused block chain"),
+            owner,
+            RealtimeArena::defaultSize());
+        FusedBlockBuild build;
+        CompilerOptions opts{true};
+
+        try
+        {
+          auto f = (*compiler)(fx_text, flags, opts, cancelled);
+          auto fun = f.target<FusedBlockFunction*>();
+          if (!fun)
+            return {};
+          build = {compiler, *fun, compiler->arena()};
+
+          if (dryRunEnabled())
+          {
+            ScopedArena arena{build.arena};
+            dryRun(build.function, controls, context);
+          }
+        }
+        catch (const std::exception& e)
+        {
+          // The stages keep running on their own
+          qDebug() << "Block fusion:" << e.what();
+          return {};
+        }
+        catch (...)
+        {
+          return {};
+        }
+
+        return [self, build] {
+          if (self)
+            self->publish(build);
+        };
+      });
+}
+
+void BlockFusion::publish(FusedBlockBuild build)
+{
+  auto current = std::make_shared<const FusedBlockBuild>(std::move(build));
+  m_state->build.store(current.get(), std::memory_order_release);
+  retireBuild(std::move(m_state->current));
+  m_state->current = std::move(current);
+}
+}
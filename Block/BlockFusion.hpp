@@ -0,0 +1,128 @@
+#pragma once
+#include <Block/AlignedChannels.hpp>
+#include <Block/BlockControls.hpp>
+#include <JitCpp/ScriptBuilds.hpp>
+
+#include <ossia/dataflow/graph_node.hpp>
+
+#include <score/document/DocumentContext.hpp>
+
+#include <QObject>
+#include <QPointer>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Jit
+{
+template <typename Fun_T>
+struct Driver;
+class BlockModel;
+class RealtimeArena;
+
+/**
+ * @brief Entry point of a fused chain of block effects.
+ *
+ * Runs every stage over tiles of a few frames, so that the samples between
+ * two stages stay in L1 instead of going through the buffers of the graph.
+ * params has the parameters of each stage, in processing order.
+ */
+using FusedBlockFunction = void(
+    const float* const* in,
+    float* const* out,
+    int channels,
+    int frames,
+    const BlockParams* const* params);
+using FusedBlockCompiler = Driver<FusedBlockFunction>;
+
+//! Channels of a fused chain ; the tiles of every channel live on the stack
+static constexpr int fusedMaxChannels = 16;
+
+//! From SCORE_JIT_NO_FUSION ; scripts also have to opt in
+bool blockFusionEnabled() noexcept;
+
+//! One source with every script of the chain, each in its own namespace
+QString generateFusedBlockFunction(const std::vector<QString>& scripts);
+
+/**
+ * @brief The chain of block effects proc belongs to, in processing order.
+ *
+ * Each stage has its audio outlet cabled only to the audio inlet of the
+ * next one, which has no other cable, in the same interval ; the outlets
+ * before the last one do not propagate. Empty when proc is not part of a
+ * chain of at least two fusible effects.
+ */
+std::vector<BlockModel*>
+blockChain(BlockModel& proc, const score::DocumentContext& doc);
+
+//! A build of the fused function ; kept alive as long as the nodes may use it
+struct FusedBlockBuild
+{
+  std::shared_ptr<FusedBlockCompiler> compiler;
+  FusedBlockFunction* function{};
+  RealtimeArena* arena{};
+};
+
+/**
+ * @brief What the nodes of a chain share on the execution thread.
+ *
+ * The first node latches the current build and converts the input of the
+ * chain once per tick ; the last one runs the fused function with the
+ * controls of every stage, which have all been updated by then as the
+ * nodes run in the order of the chain, and clears the latch. The others
+ * only update their controls. Until a build is ready, or in a tick where
+ * the first node did not latch one, each node runs its own function.
+ */
+struct BlockFusionState
+{
+  explicit BlockFusionState(int stages);
+
+  //! Written by the GUI thread ; null from a change of any stage until
+  //! the build matching its new controls is ready
+  std::atomic<const FusedBlockBuild*> build{};
+  //! GUI thread only: the published build ; the previous ones are
+  //! retired, see retireBuild
+  std::shared_ptr<const FusedBlockBuild> current;
+
+  //! Execution thread only
+  const FusedBlockBuild* active{};
+  std::vector<std::weak_ptr<const block_controls>> stages;
+  std::vector<BlockParams> params;
+  std::vector<const BlockParams*> paramPointers;
+  aligned_channels<float> in;
+  int channels{};
+};
+
+/**
+ * @brief Compiles the fused function of a chain and keeps it up to date.
+ *
+ * Shared by the executors of the stages of the chain ; recompiles when
+ * the script of any of them changes.
+ */
+class BlockFusion final : public QObject
+{
+public:
+  //! The fusion of the chain, created by the first of its executors
+  static std::shared_ptr<BlockFusion> get(const std::vector<BlockModel*>& chain);
+
+  explicit BlockFusion(const std::vector<BlockModel*>& chain);
+  ~BlockFusion() override;
+
+  const std::shared_ptr<BlockFusionState>& state() const noexcept
+  {
+    return m_state;
+  }
+
+  //! Position of a stage in the chain, -1 if it is not part of it
+  int stage(const BlockModel* proc) const noexcept;
+
+private:
+  void recompile();
+  void publish(FusedBlockBuild build);
+
+  std::vector<QPointer<BlockModel>> m_chain;
+  std::shared_ptr<BlockFusionState> m_state;
+  ScriptBuilds<FusedBlockCompiler> m_builds{"fusion", this};
+};
+}
@@ -4,12 +4,18 @@
 #include <QDialog>
 #include <QDialogButtonBox>
 #include <QPlainTextEdit>
+#include <QPointer>
 #include <QPushButton>
 #include <QSyntaxStyle>
 #include <QVBoxLayout>
 
 #include <JitCpp/Compiler/Driver.hpp>
 #include <JitCpp/EditScript.hpp>
+#include <JitCpp/ExecutionContext.hpp>
+#include <JitCpp/Profiler.hpp>
+#include <JitCpp/RealtimeArena.hpp>
+#include <JitCpp/SampleConversion.hpp>
+#include <JitCpp/WarmUp.hpp>
 
 #include <Process/Dataflow/PortFactory.hpp>
 
@@ -26,19 +32,32 @@
 W_OBJECT_IMPL(Jit::BytebeatModel)
 namespace Jit
 {
+//! Lines of generateBytebeatFunction before the expression
+static constexpr int bytebeatLineOffset = 6;
+
 QString generateBytebeatFunction(const QString& bb)
 {
   return QString(R"_(
-extern "C"
-void score_bytebeat(double* input, int size, int T)
+static inline void score_bytebeat_loop(float* output, int size, int T)
 {
-  for(auto end = input + size; input < end; ++input, ++T)
+  for(auto end = output + size; output < end; ++output, ++T)
   {
     const int t = T / 4;
     signed char expr = (%1);
-    *(input) = double(expr) / double(128.);
+    *(output) = float(expr) / 128.f;
   }
 }
+
+extern "C"
+void score_bytebeat(float* output, int size, int T)
+{
+#if defined(SCORE_JIT_BUFFER_SIZE)
+  // Constant trip count for the usual case, which unrolls & vectorizes better
+  if(size == SCORE_JIT_BUFFER_SIZE)
+    return score_bytebeat_loop(output, SCORE_JIT_BUFFER_SIZE, T);
+#endif
+  score_bytebeat_loop(output, size, T);
+}
 )_").arg(bb);
 }
 
@@ -94,7 +113,7 @@ void BytebeatModel::setScript(const QString& txt)
   if(m_text != txt)
   {
     m_text = txt;
-    reload();
+    reloadAsync(CompilePriority::Editor);
     scriptChanged(txt);
   }
 }
@@ -105,7 +124,12 @@ bool BytebeatModel::validate(const QString& txt) const noexcept
   return true;
 }
 
-void BytebeatModel::init() {}
+void BytebeatModel::init()
+{
+  // Recompile for the new buffer size and sample rate
+  ExecutionContext::onChanged(
+      this, [this] { reloadAsync(CompilePriority::Playing); });
+}
 
 QString BytebeatModel::prettyName() const noexcept
 {
@@ -114,41 +138,81 @@ QString BytebeatModel::prettyName() const noexcept
 
 void BytebeatModel::reload()
 {
-  // FIXME dispos of them once unused at execution
-  static std::list<std::shared_ptr<BytebeatCompiler>> old_compilers;
-  if (m_compiler)
-  {
-    old_compilers.push_front(std::move(m_compiler));
-    if (old_compilers.size() > 5)
-      old_compilers.pop_back();
-  }
+  m_builds.run(compileJob());
+}
 
-  m_compiler = std::make_unique<BytebeatCompiler>("score_bytebeat");
-  auto fx_text = Jit::generateBytebeatFunction(m_text).toLocal8Bit();
-  BytebeatFactory jit_factory;
-  if (fx_text.isEmpty())
-    return;
+void BytebeatModel::reloadAsync(CompilePriority prio)
+{
+  m_builds.submit(prio, compileJob());
+}
 
-  try
-  {
-    jit_factory = (*m_compiler)(fx_text.toStdString(), {}, CompilerOptions{true});
-    assert(jit_factory);
+CompileScheduler::Work BytebeatModel::compileJob()
+{
+  auto fx_text = Jit::generateBytebeatFunction(m_text).toLocal8Bit().toStdString();
+  QPointer<BytebeatModel> self = this;
+  const void* owner = this;
+  auto name = metadata().getName();
+  auto context = ExecutionContext::current();
+  auto flags = context.flags();
+  return [self, owner, name, fx_text, flags, context](
+             const CancellationToken& cancelled)
+             -> CompileScheduler::Completion {
+    if (fx_text.empty())
+      return {};
+
+    auto compiler = makeDriver<BytebeatCompiler>(
+        "score_bytebeat", name, owner, RealtimeArena::defaultSize());
+    BytebeatFactory jit_factory;
+    CompilerOptions opts{true};
+    opts.OptimizationRemarks = true;
+
+    try
+    {
+      jit_factory = (*compiler)(fx_text, flags, opts, cancelled);
+      assert(jit_factory);
+
+      if (!jit_factory)
+        return {};
+
+      // Runs the new code once here rather than for the first time on the
+      // audio thread
+      if (dryRunEnabled())
+      {
+        std::vector<float> scratch(context.bufferSize);
+        ScopedArena arena{compiler->arena()};
+        jit_factory(scratch.data(), context.bufferSize, 0);
+      }
+    }
+    catch (const std::exception& e)
+    {
+      return reportError(self, QString{e.what()});
+    }
+    catch (...)
+    {
+      return reportError(self, "JIT error");
+    }
+
+    auto remarks = remarksMessage(compiler->remarks(), bytebeatLineOffset);
+    return [self, compiler, jit_factory, remarks] {
+      if (self)
+      {
+        self->setFactory(compiler, jit_factory);
+        if (!remarks.second.empty())
+          self->errorMessage(
+              remarks.first, QString::fromStdString(remarks.second));
+      }
+    };
+  };
+}
 
-    if (!jit_factory)
-      return;
-  }
-  catch (const std::exception& e)
-  {
-    errorMessage(0, e.what());
-    return;
-  }
-  catch (...)
-  {
-    errorMessage(0, "JIT error");
-    return;
-  }
+void BytebeatModel::setFactory(
+    std::shared_ptr<BytebeatCompiler> compiler,
+    BytebeatFactory jit_factory)
+{
+  m_builds.setCurrent(std::move(compiler));
 
   factory = std::move(jit_factory);
+  arena = m_builds.current()->arena();
   changed();
 }
 
@@ -156,26 +220,36 @@ class bytebeat_node
     : public ossia::nonowning_graph_node
 {
 public:
-  bytebeat_node()
+  //! The scratch buffer is reserved for the usual buffer size
+  explicit bytebeat_node(int bufferSize)
   {
     m_outlets.push_back(&audio_out);
+    samples.reserve(bufferSize);
   }
 
-  void set_function(BytebeatFunction* func)
+  void set_function(BytebeatFunction* func, RealtimeArena* arena)
   {
     this->func = func;
+    this->arena = arena;
   }
   void run(const ossia::token_request& t, ossia::exec_state_facade f) noexcept override
   {
       ossia::audio_port& o = *audio_out;
       o.samples.resize(2);
-      o.samples[0].resize(f.bufferSize());
-      double* data = o.samples[0].data();
       int N = f.bufferSize();
+      o.samples[0].resize(N);
 
       if(func)
       {
-        func(data, N, time);
+        // The expression is 8-bit: computing in float loses nothing
+        // and converting once is cheaper than working on double
+        samples.resize(N);
+        {
+          Jit::ScopedProfile p{profile.get(), N, f.sampleRate()};
+          Jit::ScopedArena a{arena};
+          func(samples.data(), N, time);
+        }
+        Jit::convertSamples(samples.data(), o.samples[0].data(), N);
       }
       time += N;
       o.samples[1] = o.samples[0];
@@ -183,6 +257,9 @@ public:
 
   int time = 0;
   BytebeatFunction* func = nullptr;
+  RealtimeArena* arena = nullptr;
+  std::vector<float> samples;
+  std::shared_ptr<Jit::NodeProfile> profile;
   ossia::audio_outlet audio_out;
 };
 
@@ -194,20 +271,21 @@ BytebeatExecutor::BytebeatExecutor(
     QObject* parent)
     : ProcessComponent_T{proc, ctx, id, "JitComponent", parent}
 {
-  auto bb = new bytebeat_node;
+  auto bb = new bytebeat_node{ExecutionContext::current().bufferSize};
+  bb->profile = Jit::Profiler::instance().create(&proc, proc.metadata().getName());
   this->node.reset(bb);
 
-  if(auto tgt = proc.factory.target<void(*)(double* , int , int )>())
-    bb->set_function(*tgt);
+  if(auto tgt = proc.factory.target<BytebeatFunction*>())
+    bb->set_function(*tgt, proc.arena);
 
   m_ossia_process = std::make_shared<ossia::node_process>(node);
 
   con(proc, &Jit::BytebeatModel::changed,
       this, [this, &proc, bb] {
-        if(auto tgt = proc.factory.target<void(*)(double* , int , int )>())
+        if(auto tgt = proc.factory.target<BytebeatFunction*>())
         {
-          in_exec([tgt, bb] {
-            bb->set_function(*tgt);
+          in_exec([tgt, bb, arena = proc.arena] {
+            bb->set_function(*tgt, arena);
           });
         }
   });
@@ -10,6 +10,8 @@
 
 #include <Process/Script/ScriptEditor.hpp>
 #include <JitCpp/EditScript.hpp>
+#include <JitCpp/CompileScheduler.hpp>
+#include <JitCpp/ScriptBuilds.hpp>
 
 #include <Control/DefaultEffectItem.hpp>
 #include <Effect/EffectFactory.hpp>
@@ -37,7 +39,9 @@ namespace Jit
 {
 template <typename Fun_T>
 struct Driver;
-using BytebeatFunction = void(double* input, int size, int time);
+class RealtimeArena;
+//! Computes in float, see bytebeat_node
+using BytebeatFunction = void(float* output, int size, int time);
 using BytebeatCompiler = Driver<BytebeatFunction>;
 using BytebeatFactory = std::function<BytebeatFunction>;
 class BytebeatModel : public Process::ProcessModel
@@ -77,14 +81,25 @@ public:
 
   BytebeatFactory factory;
 
+  //! Where the allocations of factory go, may be nullptr
+  RealtimeArena* arena{};
+
   void errorMessage(int line, const QString& e) W_SIGNAL(errorMessage, line, e);
 
   PROPERTY(QString, script READ script WRITE setScript NOTIFY scriptChanged)
 private:
   void init();
+
+  //! Compiles synchronously, used when loading
   void reload();
+
+  //! Compiles in the background, the result is applied once ready
+  void reloadAsync(CompilePriority prio);
+  CompileScheduler::Work compileJob();
+  void setFactory(std::shared_ptr<BytebeatCompiler> compiler, BytebeatFactory factory);
+
   QString m_text;
-  std::unique_ptr<BytebeatCompiler> m_compiler;
+  ScriptBuilds<BytebeatCompiler> m_builds{"bytebeat", this};
 };
 }
 
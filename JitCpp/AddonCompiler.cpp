@@ -1,5 +1,6 @@
 #include <JitCpp/AddonCompiler.hpp>
 #include <JitCpp/Compiler/Driver.hpp>
+#include <JitCpp/CompileScheduler.hpp>
 #include <wobjectimpl.h>
 
 W_OBJECT_IMPL(Jit::AddonCompiler)
@@ -17,6 +18,20 @@ namespace llvm::orc
 #endif
 namespace Jit
 {
+// TODO this is needed because if the jit_plugin instance is removed,
+// function calls to this plug-in will crash. We must detect when a plugin
+// is not necessary anymore and remove it.
+using compiler_t = Driver<score::Plugin_QtInterface*()>;
+static std::list<std::unique_ptr<compiler_t>> ctx;
+static std::mutex ctx_mutex;
+
+// Compile jobs may run on several threads with out-of-process workers
+static compiler_t& make_compiler(const std::string& name, const QString& label)
+{
+  std::lock_guard lck{ctx_mutex};
+  return *ctx.emplace_back(std::make_unique<compiler_t>(name, label));
+}
+
 AddonCompiler::AddonCompiler()
 {
   connect(
@@ -40,28 +55,42 @@ void AddonCompiler::on_job(
     std::string cpp,
     std::vector<std::string> flags,
     CompilerOptions opts)
+{
+  // Library addons are built in the background, after what the user is
+  // working on
+  CompileScheduler::instance().submit(
+      "addon-" + id,
+      CompilePriority::Background,
+      [this, id, cpp, flags, opts](const CancellationToken&)
+          -> CompileScheduler::Completion {
+        auto instance = compile(id, cpp, flags, opts);
+        if (!instance)
+          return {};
+        return [this, instance] { jobCompleted(instance); };
+      });
+}
+
+score::Plugin_QtInterface* AddonCompiler::compile(
+    const std::string& id,
+    const std::string& cpp,
+    std::vector<std::string> flags,
+    CompilerOptions opts)
 {
   try
   {
-    // TODO this is needed because if the jit_plugin instance is removed,
-    // function calls to this plug-in will crash. We must detect when a plugin
-    // is not necessary anymore and remove it.
-    using compiler_t = Driver<score::Plugin_QtInterface*()>;
-
-    static std::list<std::unique_ptr<compiler_t>> ctx;
-
     flags.push_back("-DSCORE_JIT_ID=" + id);
 
     qDebug() << "Creating compiler...";
-    ctx.push_back(std::make_unique<compiler_t>("plugin_instance_" + id));
+    auto& compiler = make_compiler(
+        "plugin_instance_" + id, "Addon " + QString::fromStdString(id));
 
     qDebug() << "Calling compiler...";
-    auto jitedFn = (*ctx.back())(cpp, flags, opts);
+    auto jitedFn = compiler(cpp, flags, opts);
 
     if(!jitedFn)
     {
       qDebug() << "could not compile plug-in: no factory";
-      return;
+      return nullptr;
     }
 
     qDebug() << "Invoking instance...";
@@ -69,18 +98,59 @@ void AddonCompiler::on_job(
     if (!instance)
     {
       qDebug() << "could not compile plug-in: no instance";
-      return;
+      return nullptr;
     }
-    else
+
+    qDebug() << "Compiled ok !";
+    return instance;
+  }
+  catch (const std::runtime_error& e)
+  {
+    qDebug() << "could not compile plug-in: " << e.what();
+  }
+  return nullptr;
+}
+
+std::vector<score::Plugin_QtInterface*> AddonCompiler::compileBatch(
+    const std::vector<std::string>& ids,
+    const std::string& cpp,
+    std::vector<std::string> flags,
+    CompilerOptions opts)
+{
+  std::vector<score::Plugin_QtInterface*> instances(ids.size(), nullptr);
+  if (ids.empty())
+    return instances;
+
+  try
+  {
+    qDebug() << "Creating batch compiler for" << ids.size() << "plug-ins...";
+    auto& compiler = make_compiler(
+        "plugin_instance_" + ids.front(),
+        QStringLiteral("Node batch (%1)").arg(ids.size()));
+    if (!compiler(cpp, flags, opts))
     {
-      qDebug() << "Compiled ok !";
-      jobCompleted(instance);
+      qDebug() << "could not compile plug-in batch";
+      return instances;
+    }
+
+    for (std::size_t i = 0; i < ids.size(); i++)
+    {
+      try
+      {
+        if (auto fn = compiler.function("plugin_instance_" + ids[i]))
+          instances[i] = fn();
+      }
+      catch (const std::runtime_error& e)
+      {
+        qDebug() << "could not find plug-in" << ids[i].c_str() << e.what();
+      }
     }
   }
   catch (const std::runtime_error& e)
   {
-    qDebug() << "could not compile plug-in: " << e.what();
+    qDebug() << "could not compile plug-in batch: " << e.what();
   }
+  return instances;
 }
 
 }
@@ -30,6 +30,21 @@ public:
   void on_job(std::string id, std::string cpp, std::vector<std::string> flags,
               CompilerOptions opts);
 
+  //! Compiles synchronously and returns the plug-in instance, or nullptr on failure.
+  score::Plugin_QtInterface* compile(
+      const std::string& id,
+      const std::string& cpp,
+      std::vector<std::string> flags,
+      CompilerOptions opts);
+
+  //! Compiles several plug-ins from a single translation unit.
+  //! Returns the instances in the order of ids, nullptr for failures.
+  std::vector<score::Plugin_QtInterface*> compileBatch(
+      const std::vector<std::string>& ids,
+      const std::string& cpp,
+      std::vector<std::string> flags,
+      CompilerOptions opts);
+
 private:
   QThread m_thread;
 };
@@ -9,13 +9,19 @@
 #include <QDebug>
 //#include <QQuickWidget>
 #include <QThread>
+#include <QTimer>
 
 #include <JitCpp/ApplicationPlugin.hpp>
+#include <JitCpp/CompileScheduler.hpp>
 #include <JitCpp/MetadataGenerator.hpp>
+
+#include <algorithm>
+
 namespace Jit
 {
 ApplicationPlugin::ApplicationPlugin(const score::GUIApplicationContext& ctx)
     : score::GUIApplicationPlugin{ctx}
+    , m_telemetry{Telemetry::fromEnvironment()}
 {
   con(m_addonsWatch,
       &QFileSystemWatcher::directoryChanged,
@@ -28,10 +34,22 @@ ApplicationPlugin::ApplicationPlugin(const score::GUIApplicationContext& ctx)
       this,
       &ApplicationPlugin::updateAddon);
 
+  // Only directories are watched while scanning, as there is a system-wide
+  // limit on the number of watches. Nodes in use are watched individually
+  // to be reloaded when edited in place.
+  con(m_nodesWatch,
+      &QFileSystemWatcher::directoryChanged,
+      this,
+      [&](const QString& a) {
+        QTimer::singleShot(1000, this, [=] { rescanNodes(); });
+      });
   con(m_nodesWatch,
       &QFileSystemWatcher::fileChanged,
       this,
-      &ApplicationPlugin::setupNode);
+      [&](const QString& f) {
+        setupNode(f);
+        m_index.save();
+      });
 
   con(m_compiler,
       &AddonCompiler::jobCompleted,
@@ -58,6 +76,7 @@ void ApplicationPlugin::rescanAddons()
       setupAddon(p);
     }
   }
+  m_index.save();
 }
 void ApplicationPlugin::rescanNodes()
 {
@@ -65,23 +84,31 @@ void ApplicationPlugin::rescanNodes()
   QString nodes = libpath + "/Nodes";
   m_nodesWatch.addPath(nodes);
 
+  QSet<QString> seen;
   QDirIterator it{nodes,
-                  QDir::Filter::Files | QDir::Filter::NoDotAndDotDot,
+                  QDir::Filter::Dirs | QDir::Filter::Files
+                      | QDir::Filter::NoDotAndDotDot,
                   QDirIterator::Subdirectories};
   while (it.hasNext())
   {
     auto path = it.next();
-    m_nodesWatch.addPath(path);
-    if (!m_nodesPaths.contains(path))
+    const auto& fi = it.fileInfo();
+    if (fi.isDir())
     {
-      m_nodesPaths.insert(path);
-      setupAddon(path);
+      m_nodesWatch.addPath(path);
+      continue;
     }
+
+    seen.insert(fi.absoluteFilePath());
     setupNode(path);
   }
+
+  m_index.prune(QDir{nodes}.absolutePath(), seen);
+  m_index.save();
 }
 void ApplicationPlugin::initialize()
 {
+  m_index.load();
   rescanNodes();
   rescanAddons();
 
@@ -96,6 +123,55 @@ void ApplicationPlugin::registerAddon(score::Plugin_QtInterface* p)
   qDebug() << "JIT addon registered" << p;
 }
 
+//! Reads addon.json, going through the library index
+static QJsonObject
+readAddonJson(LibraryIndex& index, const QString& addon)
+{
+  QFileInfo fi{addon + "/addon.json"};
+  if (auto e = index.find(fi))
+    return e->metadata;
+
+  QFile f{fi.filePath()};
+  if (!f.open(QIODevice::ReadOnly))
+    return {};
+
+  const auto content = f.readAll();
+  auto& e = index.update(fi, content);
+  e.metadata = QJsonDocument::fromJson(content).object();
+  e.uuid = e.metadata["key"].toString();
+  return e.metadata;
+}
+
+static std::string readNodeSource(const QString& f)
+{
+  QFile file{f};
+  if (!file.open(QIODevice::ReadOnly))
+    return {};
+
+  auto node = file.readAll();
+  node.append(
+      R"_(
+        #include <score/plugins/PluginInstances.hpp>
+
+        SCORE_EXPORT_PLUGIN(Control::score_generic_plugin<Node>)
+        )_");
+  return node.toStdString();
+}
+
+static void prepareAddon(LazyAddon& addon, LibraryIndex& index)
+{
+  QFileInfo addonInfo{addon.path};
+  auto [json, cpp_files, files] = loadAddon(addon.path, index);
+  if (cpp_files.empty())
+    return;
+
+  auto addon_files_path
+      = generateAddonFiles(addonInfo.fileName(), addon.path, files, index);
+  addon.cpp = std::move(cpp_files);
+  addon.flags
+      = {"-I" + addon.path.toStdString(), "-I" + addon_files_path.toStdString()};
+}
+
 void ApplicationPlugin::setupAddon(const QString& addon)
 {
   qDebug() << "Registering JIT addon" << addon;
@@ -104,53 +180,220 @@ void ApplicationPlugin::setupAddon(const QString& addon)
   if (addonFolderName == "Nodes")
     return;
 
-  auto [json, cpp_files, files] = loadAddon(addon);
+  const auto json = readAddonJson(m_index, addon);
+  const std::string id
+      = json["key"].toString().remove(QChar('-')).toStdString();
 
-  if (cpp_files.empty())
+  // Addons which declare their processes in addon.json are only read
+  // and built when one of these processes is needed
+  if (auto processes = parseAddonProcesses(json); !processes.empty())
+  {
+    registerLazyAddon(LazyAddon{addon, id, {}, {}, std::move(processes)});
     return;
+  }
 
-  auto addon_files_path = generateAddonFiles(addonFolderName, addon, files);
-  std::vector<std::string> flags
-      = {"-I" + addon.toStdString(), "-I" + addon_files_path.toStdString()};
+  LazyAddon eager{addon, id};
+  prepareAddon(eager, m_index);
+  if (eager.cpp.empty())
+    return;
 
-  const std::string id
-      = json["key"].toString().remove(QChar('-')).toStdString();
-  m_compiler.submitJob(id, cpp_files, flags, CompilerOptions{});
+  m_compiler.submitJob(id, eager.cpp, eager.flags, CompilerOptions{});
 }
 
 void ApplicationPlugin::setupNode(const QString& f)
 {
   QFileInfo fi{f};
-  if (fi.suffix() == "hpp" || fi.suffix() == "cpp")
+  if (fi.suffix() != "hpp" && fi.suffix() != "cpp")
+    return;
+
+  LazyProcessInfo info;
+  bool changed = false;
+  if (auto e = m_index.find(fi))
+  {
+    if (e->uuid.isEmpty())
+      return;
+
+    info.uuid = e->uuid;
+    info.prettyName = e->metadata["Name"].toString();
+    info.category = e->metadata["Category"].toString();
+  }
+  else
+  {
+    QFile file{f};
+    if (!file.open(QIODevice::ReadOnly))
+      return;
+
+    const auto node = file.readAll();
+    auto& e = m_index.update(fi, node);
+    auto parsed = parseNodeMetadata(node);
+    if (!parsed)
+      return;
+
+    info = *parsed;
+    e.uuid = info.uuid;
+    e.metadata["Name"] = info.prettyName;
+    e.metadata["Category"] = info.category;
+    changed = true;
+  }
+
+  auto uuid = info.uuid;
+  uuid.remove(QChar('-'));
+  if (info.prettyName.isEmpty())
+    info.prettyName = fi.baseName();
+  if (info.category.isEmpty())
+    info.category = "Nodes";
+
+  const auto id = uuid.toStdString();
+  auto it = m_lazyAddons.find(id);
+  if (it != m_lazyAddons.end())
   {
-    if (QFile file{f}; file.open(QIODevice::ReadOnly))
+    if (!changed)
+      return;
+
+    if (it->second.instance)
     {
-      auto node = file.readAll();
-      constexpr auto make_uuid_s = "make_uuid";
-      auto make_uuid = node.indexOf(make_uuid_s);
-      if (make_uuid == -1)
-        return;
-      int umin = node.indexOf('"', make_uuid + 9);
-      if (umin == -1)
-        return;
-      int umax = node.indexOf('"', umin + 1);
-      if (umax == -1)
-        return;
-      if ((umax - umin) != 37)
-        return;
-      auto uuid = QString{node.mid(umin + 1, 36)};
-      uuid.remove(QChar('-'));
-
-      node.append(
-          R"_(
-            #include <score/plugins/PluginInstances.hpp>
-
-            SCORE_EXPORT_PLUGIN(Control::score_generic_plugin<Node>)
-            )_");
-
-      qDebug() << "Registering JIT node" << f;
-      m_compiler.submitJob(uuid.toStdString(), node.toStdString(), {}, CompilerOptions{});
+      // Already in use: the node was edited, rebuild it right away
+      qDebug() << "Reloading JIT node" << f;
+      it->second.cpp = readNodeSource(f);
+      m_compiler.submitJob(id, it->second.cpp, {}, CompilerOptions{});
     }
+    else
+    {
+      // Will be read again on first use
+      it->second.cpp.clear();
+    }
+    return;
+  }
+
+  if (!m_nodeGraph.add(id, f))
+    return;
+
+  qDebug() << "Registering JIT node" << f;
+  LazyAddon node{f, id, {}, {}, {info}};
+  node.node = true;
+  registerLazyAddon(std::move(node));
+}
+
+void ApplicationPlugin::registerLazyAddon(LazyAddon addon)
+{
+  const auto id = addon.id;
+  auto it = m_lazyAddons.find(id);
+  if (it != m_lazyAddons.end())
+  {
+    // Only the sources changed: the placeholders are still valid
+    it->second.cpp = std::move(addon.cpp);
+    it->second.flags = std::move(addon.flags);
+    return;
+  }
+
+  auto& lazy = m_lazyAddons.emplace(id, std::move(addon)).first->second;
+  auto& placeholder = m_placeholders.emplace_back(
+      std::make_unique<PlaceholderPlugin>(
+          lazy, [this](const std::string& id) { return instantiate(id); }));
+
+  score::GUIApplicationInterface::instance().registerPlugin(*placeholder);
+}
+
+score::Plugin_QtInterface* ApplicationPlugin::instantiate(const std::string& id)
+{
+  auto it = m_lazyAddons.find(id);
+  if (it == m_lazyAddons.end())
+    return nullptr;
+
+  auto& lazy = it->second;
+  if (!lazy.instance && lazy.node)
+    instantiateNodeBatch(id);
+
+  if (!lazy.instance)
+  {
+    if (lazy.cpp.empty())
+    {
+      if (lazy.node)
+        lazy.cpp = readNodeSource(lazy.path);
+      else
+        prepareAddon(lazy, m_index);
+      m_index.save();
+    }
+
+    // Something is waiting for this process: this can't go through the queue
+    CompileScheduler::instance().runNow([&](const CancellationToken&) {
+      lazy.instance = m_compiler.compile(
+          lazy.id, lazy.cpp, lazy.flags, CompilerOptions{});
+      return CompileScheduler::Completion{};
+    });
+
+    // The real factories replace the placeholders once we are out of the
+    // placeholder which requested the compilation.
+    if (auto p = lazy.instance)
+      QTimer::singleShot(0, this, [this, p] { registerAddon(p); });
+
+    if (lazy.node)
+    {
+      m_nodeGraph.setBuilt(id);
+      m_nodesWatch.addPath(lazy.path);
+    }
+  }
+  return lazy.instance;
+}
+
+void ApplicationPlugin::instantiateNodeBatch(const std::string& id)
+{
+  auto batch = m_nodeGraph.batchFor(id);
+  if (batch.ids.size() < 2)
+    return;
+
+  buildNodeBatch(batch);
+}
+
+void ApplicationPlugin::buildNodeBatch(const NodeBuildGraph::Batch& batch)
+{
+  // Built alone on first use, so that a broken node does not make every
+  // later batch fail again
+  if (batch.ids.size() < 2)
+  {
+    for (const auto& id : batch.ids)
+      m_nodeGraph.setUnbatched(id);
+    return;
+  }
+
+  qDebug() << "Building" << batch.ids.size() << "JIT nodes in one batch";
+  std::vector<score::Plugin_QtInterface*> instances;
+  CompileScheduler::instance().runNow([&](const CancellationToken&) {
+    instances = m_compiler.compileBatch(
+        batch.ids, batch.cpp, batch.flags, CompilerOptions{});
+    return CompileScheduler::Completion{};
+  });
+
+  if (std::none_of(instances.begin(), instances.end(), [](auto p) {
+        return p != nullptr;
+      }))
+  {
+    const auto half = batch.ids.begin() + batch.ids.size() / 2;
+    buildNodeBatch(
+        m_nodeGraph.batch(std::vector<std::string>(batch.ids.begin(), half)));
+    buildNodeBatch(
+        m_nodeGraph.batch(std::vector<std::string>(half, batch.ids.end())));
+    return;
+  }
+
+  for (std::size_t i = 0; i < batch.ids.size(); i++)
+  {
+    // Its entry point is missing
+    auto p = instances[i];
+    if (!p)
+    {
+      m_nodeGraph.setUnbatched(batch.ids[i]);
+      continue;
+    }
+
+    auto it = m_lazyAddons.find(batch.ids[i]);
+    if (it == m_lazyAddons.end() || it->second.instance)
+      continue;
+
+    it->second.instance = p;
+    m_nodeGraph.setBuilt(batch.ids[i]);
+    m_nodesWatch.addPath(it->second.path);
+    QTimer::singleShot(0, this, [this, p] { registerAddon(p); });
   }
 }
 
@@ -6,6 +6,12 @@
 #include <QThread>
 
 #include <JitCpp/AddonCompiler.hpp>
+#include <JitCpp/LazyAddon.hpp>
+#include <JitCpp/LibraryIndex.hpp>
+#include <JitCpp/NodeBuildGraph.hpp>
+#include <JitCpp/Telemetry.hpp>
+
+#include <unordered_map>
 
 namespace Jit
 {
@@ -25,10 +31,29 @@ struct ApplicationPlugin final : public QObject,
   void rescanAddons();
   void rescanNodes();
 
+  //! Registers placeholder factories; the addon is compiled on first use
+  void registerLazyAddon(LazyAddon addon);
+
+  //! Compiles a lazy addon right now if it was not already done
+  score::Plugin_QtInterface* instantiate(const std::string& id);
+
+  //! Builds id along with the other nodes not built yet
+  void instantiateNodeBatch(const std::string& id);
+
+  //! When the batch fails, its halves are built again until the nodes
+  //! which break it are found ; those are then only built alone
+  void buildNodeBatch(const NodeBuildGraph::Batch& batch);
+
   QFileSystemWatcher m_addonsWatch;
   QFileSystemWatcher m_nodesWatch;
   QSet<QString> m_addonsPaths;
-  QSet<QString> m_nodesPaths;
   AddonCompiler m_compiler;
+  LibraryIndex m_index;
+  NodeBuildGraph m_nodeGraph;
+
+  std::unordered_map<std::string, LazyAddon> m_lazyAddons;
+  std::vector<std::unique_ptr<PlaceholderPlugin>> m_placeholders;
+
+  std::unique_ptr<Telemetry> m_telemetry;
 };
 }
@@ -11,9 +11,14 @@
 #endif
 
 #include <JitCpp/ClangDriver.hpp>
+#include <JitCpp/CompileStats.hpp>
+#include <JitCpp/Compiler/DependencyManifest.hpp>
+#include <JitCpp/Compiler/RealtimeCheck.hpp>
 
-#include <QCryptographicHash>
 #include <QStandardPaths>
+
+#include <chrono>
+#include <mutex>
 #include <sstream>
 
 namespace Jit
@@ -46,16 +51,22 @@ std::optional<QDir> ClangCC1Driver::bitcodeDatabase()
   return dir;
 }
 
-static QString hashFile(const QString& path)
+std::vector<std::string> ClangCC1Driver::dependencyArgs(const std::string& cpp)
 {
-  QFile f{path};
-  SCORE_ASSERT(f.open(QIODevice::ReadOnly));
+  // System headers too: score, Qt and the standard library can change
+  return {"-dependency-file", replaceExtension(cpp, "d"), "-MT", cpp,
+          "-sys-header-deps"};
+}
 
-  QCryptographicHash hash{QCryptographicHash::Sha1};
-  hash.addData(&f);
+std::vector<std::string> ClangCC1Driver::readDependencies(const std::string& cpp)
+{
+  const auto depFile = replaceExtension(cpp, "d");
+  auto deps = readDependencyFile(depFile);
+  llvm::sys::fs::remove(depFile);
 
-  return hash.result().toBase64(
-      QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+  // The source itself is a temporary file, already part of the cache key
+  deps.erase(std::remove(deps.begin(), deps.end(), cpp), deps.end());
+  return deps;
 }
 
 llvm::Expected<std::unique_ptr<llvm::Module>>
@@ -65,9 +76,7 @@ ClangCC1Driver::compileTranslationUnit(
     CompilerOptions opts,
     llvm::LLVMContext& context)
 {
-  std::string bitcodeFile;
-
-  std::string preproc = replaceExtension(cpp, "preproc.cpp");
+  const std::string bitcodeFile = replaceExtension(cpp, "bc");
 
   // Default flags
   auto flags_vec = getClangCC1Args(opts);
@@ -79,71 +88,21 @@ ClangCC1Driver::compileTranslationUnit(
   // Additional flags
   flags_vec.insert(flags_vec.end(), flags.begin(), flags.end());
 
-  // First do a preprocessing pass that we will hash
-  flags_vec.push_back("-E");
-  flags_vec.push_back("-P");
+  // Record the included files for the object cache manifest
+  const auto deps = dependencyArgs(cpp);
+  flags_vec.insert(flags_vec.end(), deps.begin(), deps.end());
+
   flags_vec.push_back("-o");
-  flags_vec.push_back(preproc);
+  flags_vec.push_back(bitcodeFile);
   flags_vec.push_back(cpp);
-/*
-  {
-    Timer t;
-    llvm::Error err = compileCppToBitcodeFile(flags_vec);
-    if (err)
-      return std::move(err);
-  }
-
-  const auto cache_dir = bitcodeDatabase();
 
-  auto preproc_hash = hashFile(QString::fromStdString(preproc));
-  {
-    if (cache_dir && cache_dir->exists())
-    {
-      QDirIterator it(*cache_dir);
-      while (it.hasNext())
-      {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.fileName() == preproc_hash + ".bc")
-        {
-          bitcodeFile = fi.absoluteFilePath().toStdString();
-          break;
-        }
-      }
-    }
-  }
-*/
-  // If there isn't a matching bitcode file, do the actual C++ -> bitcode
-  // compilation
-  if (bitcodeFile.empty())
-  {
-    bitcodeFile = replaceExtension(cpp, "bc");
-    flags_vec.resize(flags_vec.size() - 5);
-    flags_vec.push_back("-o");
-    flags_vec.push_back(bitcodeFile);
-    flags_vec.push_back(cpp);
-
-    Timer t;
-    llvm::Error err = compileCppToBitcodeFile(flags_vec);
-    if (err)
-      return std::move(err);
-
-    /* TODO FIX CACHE
-    if (cache_dir && cache_dir->exists())
-    {
-      QFile f(QString::fromStdString(bitcodeFile));
-      if (!f.copy(cache_dir->absolutePath() + "/" + preproc_hash + ".bc"))
-      {
-        qDebug() << "Writing"
-                 << cache_dir->absolutePath() + "/" + preproc_hash + ".bc"
-                 << " : failed !";
-      }
-    }
-    */
-  }
+  m_remarks.clear();
+  llvm::Error err = compileCppToBitcodeFile(flags_vec, &m_remarks);
+  m_dependencies = readDependencies(cpp);
+  if (err)
+    return std::move(err);
 
   // Load the bitcode
-  Timer t;
   auto module = readModuleFromBitcodeFile(bitcodeFile, context);
 
   llvm::sys::fs::remove(bitcodeFile);
@@ -156,6 +115,17 @@ ClangCC1Driver::compileTranslationUnit(
 
   m_deleters.push_back([cpp]() { llvm::sys::fs::remove(cpp); });
 
+  if (opts.RealtimeCheck)
+  {
+    auto unsafe = checkRealtimeSafety(**module);
+    if (opts.RealtimeStrict && !unsafe.empty())
+      return llvm::createStringError(
+          llvm::inconvertibleErrorCode(),
+          "error : the audio code is not real-time safe\n"
+              + remarksMessage(unsafe).second);
+    m_remarks.insert(m_remarks.end(), unsafe.begin(), unsafe.end());
+  }
+
   return std::move(*module);
 }
 
@@ -199,9 +169,81 @@ std::vector<std::string> ClangCC1Driver::getClangCC1Args(CompilerOptions opts)
   return args;
 }
 
-llvm::Error
-ClangCC1Driver::compileCppToBitcodeFile(const std::vector<std::string>& args)
+std::vector<std::string> ClangCC1Driver::getObjectArgs(
+    const std::vector<std::string>& flags,
+    CompilerOptions opts)
+{
+  auto args = getClangCC1Args(opts);
+
+  // Replace -emit-llvm -emit-llvm-bc -emit-llvm-uselists
+  args.erase(args.begin(), args.begin() + 3);
+  args.insert(args.begin(), "-emit-obj");
+
+  args.push_back("-x");
+  args.push_back("c++");
+  args.insert(args.end(), flags.begin(), flags.end());
+  return args;
+}
+
+namespace
+{
+//! Keeps the errors, and the remarks with their line as the source manager
+//! does not outlive cc1_main
+class CompileDiagnostics final : public clang::DiagnosticConsumer
+{
+public:
+  void HandleDiagnostic(
+      clang::DiagnosticsEngine::Level level,
+      const clang::Diagnostic& info) override
+  {
+    DiagnosticConsumer::HandleDiagnostic(level, info);
+
+    llvm::SmallString<256> msg;
+    info.FormatDiagnostic(msg);
+
+    if (level >= clang::DiagnosticsEngine::Error)
+    {
+      errors << "error : " << msg.c_str() << "\n";
+    }
+    else if (level == clang::DiagnosticsEngine::Remark && info.hasSourceManager())
+    {
+      // Only what the script author wrote, not the headers
+      auto& sm = info.getSourceManager();
+      const auto loc = info.getLocation();
+      if (loc.isInvalid() || !sm.isInMainFile(loc))
+        return;
+
+      remarks.push_back(CompileRemark{
+          int(sm.getPresumedLoc(loc).getLine()),
+          clang::DiagnosticIDs::getWarningOptionForDiag(info.getID()).str(),
+          msg.str().str()});
+    }
+  }
+
+  std::stringstream errors;
+  std::vector<CompileRemark> remarks;
+};
+}
+
+namespace
+{
+//! cc1_main installs process-wide handlers: one frontend runs at a time.
+//! A synchronous build on the GUI thread blocks for at most the frontend
+//! of the background one: it may be called from a deserializer, where the
+//! event loop must not run.
+std::unique_lock<std::mutex> lockFrontend()
+{
+  static std::mutex frontend;
+  return std::unique_lock{frontend};
+}
+}
+
+llvm::Error ClangCC1Driver::compileCppToBitcodeFile(
+    const std::vector<std::string>& args,
+    std::vector<CompileRemark>* remarks)
 {
+  auto frontend = lockFrontend();
+
   std::vector<const char*> argsX;
   argsX.reserve(args.size());
   std::transform(
@@ -210,15 +252,32 @@ ClangCC1Driver::compileCppToBitcodeFile(const std::vector<std::string>& args)
       std::back_inserter(argsX),
       [](const std::string& s) { return s.c_str(); });
 
-  auto diags = std::make_unique<clang::TextDiagnosticBuffer>();
-
-  if (int res = cc1_main(argsX, "", nullptr, diags.get()))
-  {
-    std::stringstream ss;
-    for (auto it = diags->err_begin(); it != diags->err_end(); ++it)
-      ss << "error : " << it->second << "\n";
-    return return_code_error(ss.str(), res);
-  }
+  CompileStats stats;
+  if (auto main = std::find(args.begin(), args.end(), "-main-file-name");
+      main != args.end() && main + 1 != args.end())
+    stats.file = *(main + 1);
+  stats.rssBefore = residentMemory();
+  const auto t0 = std::chrono::steady_clock::now();
+
+  auto diags = std::make_unique<CompileDiagnostics>();
+  const int res = cc1_main(argsX, "", nullptr, diags.get());
+
+  const auto errors = diags->errors.str();
+  if (remarks)
+    *remarks = std::move(diags->remarks);
+  diags.reset();
+
+  // Without -disable-free the frontend is gone by now: give its memory back
+  releaseFreeMemory();
+  stats.rssAfter = residentMemory();
+  frontend.unlock();
+  stats.milliseconds = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - t0)
+                           .count();
+  CompileStatistics::instance().record(std::move(stats));
+
+  if (res)
+    return return_code_error(errors, res);
 
   return llvm::Error::success();
 }
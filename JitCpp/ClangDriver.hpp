@@ -1,7 +1,6 @@
 #pragma once
 #include <JitCpp/JitPlatform.hpp>
 #include <JitCpp/JitUtils.hpp>
-#include <clang/Frontend/TextDiagnosticBuffer.h>
 
 #include <string>
 #include <vector>
@@ -22,15 +21,41 @@ public:
       CompilerOptions opts,
       llvm::LLVMContext& context);
 
+  //! Arguments to build an object file, without the input and output files
+  static std::vector<std::string> getObjectArgs(
+      const std::vector<std::string>& flags,
+      CompilerOptions opts);
+
+  //! Files included by the last compileTranslationUnit
+  const std::vector<std::string>& dependencies() const noexcept
+  {
+    return m_dependencies;
+  }
+
+  //! Arguments to write the included files of cpp to a dependency file
+  static std::vector<std::string> dependencyArgs(const std::string& cpp);
+
+  //! Reads and removes the dependency file written for cpp
+  static std::vector<std::string> readDependencies(const std::string& cpp);
+
+  //! Optimization remarks of the last compileTranslationUnit
+  const std::vector<CompileRemark>& remarks() const noexcept
+  {
+    return m_remarks;
+  }
+
+  //! Actual invocation of clang
+  static llvm::Error compileCppToBitcodeFile(
+      const std::vector<std::string>& args,
+      std::vector<CompileRemark>* remarks = nullptr);
+
 private:
   //! Default compiler arguments
   static std::vector<std::string> getClangCC1Args(CompilerOptions opts);
 
-  //! Actual invocation of clang
-  static llvm::Error
-  compileCppToBitcodeFile(const std::vector<std::string>& args);
-
   std::vector<std::function<void()>> m_deleters;
+  std::vector<std::string> m_dependencies;
+  std::vector<CompileRemark> m_remarks;
 };
 
 }
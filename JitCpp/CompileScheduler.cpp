@@ -0,0 +1,211 @@
+#include <JitCpp/CompileScheduler.hpp>
+#include <JitCpp/CompileWorker.hpp>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMetaObject>
+
+#include <algorithm>
+
+namespace Jit
+{
+
+CompileScheduler& CompileScheduler::instance()
+{
+  static CompileScheduler sched;
+  return sched;
+}
+
+CompileScheduler::CompileScheduler()
+{
+  const int threads = std::max(1, CompileWorkerPool::instance().count());
+  for (int i = 0; i < threads; i++)
+    m_threads.emplace_back([this] { run(); });
+}
+
+CompileScheduler::~CompileScheduler()
+{
+  {
+    std::lock_guard lck{m_mutex};
+    m_stop = true;
+    for (auto& [key, token] : m_latest)
+      *token = true;
+  }
+  m_cv.notify_all();
+  for (auto& t : m_threads)
+    t.join();
+
+  // Queued while the threads were stopping
+  for (auto& [thread, f] : m_disposals)
+    f();
+}
+
+void CompileScheduler::submit(std::string key, CompilePriority prio, Work work)
+{
+  {
+    std::lock_guard lck{m_mutex};
+
+    // Whether the previous job with this key is pending, compiling or
+    // waiting for its result to be delivered, it is now obsolete
+    auto token = std::make_shared<std::atomic_bool>(false);
+    if (auto& latest = m_latest[key])
+      *latest = true;
+    m_latest[key] = token;
+
+    auto it = std::find_if(
+        m_pending.begin(), m_pending.end(), [&](const Job& j) {
+          return j.key == key;
+        });
+
+    if (it != m_pending.end())
+    {
+      // Coalesce: only the latest version of a job is worth compiling
+      it->priority = std::min(it->priority, prio);
+      it->work = std::move(work);
+      it->cancelled = std::move(token);
+    }
+    else
+    {
+      m_pending.push_back(
+          Job{std::move(key), prio, std::move(work), std::move(token)});
+    }
+  }
+  m_cv.notify_one();
+}
+
+void CompileScheduler::cancel(const std::string& key)
+{
+  std::lock_guard lck{m_mutex};
+  if (auto it = m_latest.find(key); it != m_latest.end())
+  {
+    *it->second = true;
+    m_latest.erase(it);
+  }
+
+  m_pending.erase(
+      std::remove_if(
+          m_pending.begin(),
+          m_pending.end(),
+          [&](const Job& j) { return j.key == key; }),
+      m_pending.end());
+}
+
+CompileScheduler::Completion CompileScheduler::runNow(const Work& work)
+{
+  return work(std::make_shared<std::atomic_bool>(false));
+}
+
+void CompileScheduler::destroyOn(std::thread::id thread, std::function<void()> f)
+{
+  if (thread == std::this_thread::get_id())
+  {
+    f();
+    return;
+  }
+
+  bool stopping{};
+  {
+    std::lock_guard lck{m_mutex};
+    stopping = m_stop;
+    const bool compileThread = std::any_of(
+        m_threads.begin(), m_threads.end(), [&](const std::thread& t) {
+          return t.get_id() == thread;
+        });
+    if (compileThread && !stopping)
+    {
+      m_disposals.emplace_back(thread, std::move(f));
+      m_cv.notify_all();
+      return;
+    }
+  }
+
+  // Built by a synchronous job
+  if (auto app = QCoreApplication::instance(); app && !stopping)
+    QMetaObject::invokeMethod(app, std::move(f), Qt::QueuedConnection);
+  else
+    f();
+}
+
+void CompileScheduler::runDisposals(std::unique_lock<std::mutex>& lck)
+{
+  const auto self = std::this_thread::get_id();
+  for (auto it = m_disposals.begin(); it != m_disposals.end();)
+  {
+    if (it->first != self)
+    {
+      ++it;
+      continue;
+    }
+
+    auto f = std::move(it->second);
+    m_disposals.erase(it);
+    lck.unlock();
+    f();
+    lck.lock();
+    it = m_disposals.begin();
+  }
+}
+
+void CompileScheduler::run()
+{
+  for (;;)
+  {
+    Job job;
+    {
+      std::unique_lock lck{m_mutex};
+      const auto self = std::this_thread::get_id();
+      auto mine = [&] {
+        return std::any_of(
+            m_disposals.begin(), m_disposals.end(), [&](const auto& d) {
+              return d.first == self;
+            });
+      };
+      m_cv.wait(lck, [&] { return m_stop || !m_pending.empty() || mine(); });
+      runDisposals(lck);
+      if (m_stop)
+        return;
+      if (m_pending.empty())
+        continue;
+
+      // Highest priority first, then in submission order
+      auto it = std::min_element(
+          m_pending.begin(), m_pending.end(), [](const Job& lhs, const Job& rhs) {
+            return lhs.priority < rhs.priority;
+          });
+      job = std::move(*it);
+      m_pending.erase(it);
+    }
+
+    Completion done;
+    try
+    {
+      if (!*job.cancelled)
+        done = job.work(job.cancelled);
+    }
+    catch (const std::exception& e)
+    {
+      qDebug() << "JIT job" << job.key.c_str() << "failed:" << e.what();
+    }
+
+    if (done && !*job.cancelled)
+    {
+      QMetaObject::invokeMethod(
+          qApp,
+          [this, done = std::move(done), key = job.key, cancelled = job.cancelled] {
+            // A newer version may have been submitted in the meantime
+            if (*cancelled)
+              return;
+
+            {
+              std::lock_guard lck{m_mutex};
+              if (auto it = m_latest.find(key);
+                  it != m_latest.end() && it->second == cancelled)
+                m_latest.erase(it);
+            }
+            done();
+          },
+          Qt::QueuedConnection);
+    }
+  }
+}
+}
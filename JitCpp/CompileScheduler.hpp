@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <score_addon_jit_export.h>
+
+namespace Jit
+{
+//! Lower values are compiled first
+enum class CompilePriority
+{
+  Editor,     //!< The script the user is editing
+  Playing,    //!< Processes currently running
+  Background  //!< Library addons & nodes
+};
+
+using CancellationToken = std::shared_ptr<std::atomic_bool>;
+
+/**
+ * @brief Runs the JIT compilations one at a time, by priority.
+ *
+ * Jobs are identified by a key (e.g. the process being edited) :
+ * submitting a job with the key of a pending one replaces it, and cancels
+ * the one currently compiling if any. A cancelled job stops at the next
+ * stage of the compilation, and its result is never delivered.
+ *
+ * The work of a job runs on a compile thread, and returns a completion
+ * which is executed on the GUI thread. When compile workers are enabled,
+ * there are as many compile threads as workers. In-process, only the clang
+ * frontend is serialized, see ClangCC1Driver::compileCppToBitcodeFile.
+ */
+class SCORE_ADDON_JIT_EXPORT CompileScheduler
+{
+public:
+  using Completion = std::function<void()>;
+  using Work = std::function<Completion(const CancellationToken&)>;
+
+  static CompileScheduler& instance();
+
+  CompileScheduler();
+  ~CompileScheduler();
+
+  void submit(std::string key, CompilePriority prio, Work work);
+
+  //! Cancels the pending and running jobs with this key
+  void cancel(const std::string& key);
+
+  //! Runs a job synchronously on the calling thread, alongside the
+  //! background ones, and returns its completion.
+  Completion runNow(const Work& work);
+
+  //! Runs f on the given thread: a compile thread, else the GUI thread.
+  //! Used to destroy what has to be on the thread which created it.
+  void destroyOn(std::thread::id thread, std::function<void()> f);
+
+private:
+  struct Job
+  {
+    std::string key;
+    CompilePriority priority{};
+    Work work;
+    CancellationToken cancelled;
+  };
+
+  void run();
+  void runDisposals(std::unique_lock<std::mutex>& lck);
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<Job> m_pending;
+
+  //! Token of the most recent job submitted for each key
+  std::unordered_map<std::string, CancellationToken> m_latest;
+  bool m_stop{};
+
+  //! Functions to run on a given compile thread, see destroyOn
+  std::vector<std::pair<std::thread::id, std::function<void()>>> m_disposals;
+
+  //! One per compile worker process, or a single one for in-process builds
+  std::vector<std::thread> m_threads;
+};
+}
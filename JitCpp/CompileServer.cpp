@@ -0,0 +1,202 @@
+#include <JitCpp/CompileServer.hpp>
+#include <JitCpp/Compiler/ObjectCache.hpp>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QEventLoop>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QThread>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+namespace Jit
+{
+QString compileServerSocketName()
+{
+  auto name = qEnvironmentVariable("SCORE_JIT_SOCKET");
+  return name.isEmpty() ? QStringLiteral("score-jit") : name;
+}
+
+bool isCompileServer()
+{
+  return qEnvironmentVariableIsSet("SCORE_JIT_SERVE");
+}
+
+CompileServerClient& CompileServerClient::instance()
+{
+  static CompileServerClient client;
+  return client;
+}
+
+CompileServerClient::CompileServerClient()
+    : m_enabled{
+        qEnvironmentVariableIsSet("SCORE_JIT_SERVER") && !isCompileServer()
+        && !isCompileWorker()}
+{
+}
+
+std::optional<CompileResponse>
+CompileServerClient::compile(const CompileRequest& req)
+{
+  // Like QProcess, QLocalSocket can only be used from its own thread
+  thread_local std::unique_ptr<QLocalSocket> socket;
+  if (!socket || socket->state() != QLocalSocket::ConnectedState)
+  {
+    socket = std::make_unique<QLocalSocket>();
+    socket->connectToServer(compileServerSocketName());
+    if (!socket->waitForConnected(1000))
+    {
+      qDebug() << "JIT compile server unreachable:" << socket->errorString();
+      socket.reset();
+      return std::nullopt;
+    }
+  }
+
+  writeRequest(*socket, req);
+
+  // A hung server: the next request reconnects, this one goes elsewhere
+  CompileResponse res;
+  if (!readResponse(*socket, res, compileTimeout()))
+  {
+    qDebug() << "JIT compile server did not answer:" << socket->errorString();
+    socket->abort();
+    socket.reset();
+    return std::nullopt;
+  }
+  return res;
+}
+
+std::optional<CompileResponse> compileOutOfProcess(const CompileRequest& req)
+{
+  if (auto& server = CompileServerClient::instance(); server.enabled())
+  {
+    if (auto res = server.compile(req))
+      return res;
+  }
+
+  if (auto& workers = CompileWorkerPool::instance(); workers.enabled())
+    if (auto res = workers.compile(req))
+      return res;
+
+  return std::nullopt;
+}
+
+namespace
+{
+//! Compiles each distinct request once, whatever the number of clients
+class CompileServer
+{
+public:
+  CompileResponse handle(const CompileRequest& req)
+  {
+    CompilerOptions opts;
+    opts.RealtimeCheck = req.realtimeCheck;
+    const auto key = ObjectCache::key(req.source, req.args, opts);
+    if (auto obj = m_cache.load(key))
+      return CompileResponse{
+          true,
+          {},
+          obj->getBuffer().str(),
+          m_cache.dependencies(key),
+          m_cache.remarks(key)};
+
+    std::shared_ptr<InFlight> job;
+    bool compiling = false;
+    {
+      std::lock_guard lck{m_mutex};
+      auto& cur = m_inflight[key];
+      if (!cur)
+      {
+        cur = std::make_shared<InFlight>();
+        compiling = true;
+      }
+      job = cur;
+    }
+
+    if (compiling)
+    {
+      CompileResponse res;
+      {
+        // clang is not reentrant
+        std::lock_guard lck{m_compileMutex};
+        res = compileRequest(req);
+      }
+
+      if (res.ok)
+      {
+        m_cache.storeDependencies(key, res.dependencies, res.remarks);
+        m_cache.store(key, llvm::MemoryBufferRef{res.object, key});
+      }
+
+      std::lock_guard lck{m_mutex};
+      job->response = res;
+      job->done = true;
+      m_inflight.erase(key);
+      job->cv.notify_all();
+      return res;
+    }
+    else
+    {
+      qDebug() << "JIT compile server: joining identical request";
+      std::unique_lock lck{m_mutex};
+      job->cv.wait(lck, [&] { return job->done; });
+      return job->response;
+    }
+  }
+
+private:
+  struct InFlight
+  {
+    std::condition_variable cv;
+    bool done{};
+    CompileResponse response;
+  };
+
+  ObjectCache m_cache;
+  std::mutex m_mutex;
+  std::mutex m_compileMutex;
+  std::map<std::string, std::shared_ptr<InFlight>> m_inflight;
+};
+}
+
+int runCompileServer()
+{
+  const auto name = compileServerSocketName();
+  QLocalServer::removeServer(name);
+
+  QLocalServer server;
+  server.setSocketOptions(QLocalServer::UserAccessOption);
+  if (!server.listen(name))
+  {
+    qDebug() << "JIT compile server: cannot listen on" << name << ":"
+             << server.errorString();
+    return 1;
+  }
+  qDebug() << "JIT compile server listening on" << server.fullServerName();
+
+  CompileServer impl;
+  QObject::connect(&server, &QLocalServer::newConnection, [&] {
+    while (auto socket = server.nextPendingConnection())
+    {
+      // Each client gets a thread doing blocking reads ; requests from
+      // several clients are deduplicated by CompileServer.
+      socket->setParent(nullptr);
+      auto thread = QThread::create([socket, &impl] {
+        CompileRequest req;
+        while (readRequest(*socket, req))
+          writeResponse(*socket, impl.handle(req));
+        delete socket;
+      });
+      socket->moveToThread(thread);
+      QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+      thread->start();
+    }
+  });
+
+  QEventLoop loop;
+  return loop.exec();
+}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <JitCpp/CompileWorker.hpp>
+
+#include <optional>
+
+namespace Jit
+{
+/**
+ * @brief Client of the machine-local compile server.
+ *
+ * Several score instances on the same host can share a single compile
+ * server : it holds the object cache for all of them, and identical requests
+ * sent concurrently by several clients are only compiled once.
+ *
+ * The server is the score executable started with SCORE_JIT_SERVE=1 ;
+ * clients use it when started with SCORE_JIT_SERVER=1. The socket name
+ * can be changed with SCORE_JIT_SOCKET on both sides.
+ */
+class SCORE_ADDON_JIT_EXPORT CompileServerClient
+{
+public:
+  static CompileServerClient& instance();
+
+  bool enabled() const noexcept { return m_enabled; }
+
+  //! Returns nothing if the server could not be reached
+  std::optional<CompileResponse> compile(const CompileRequest& req);
+
+private:
+  CompileServerClient();
+  bool m_enabled{};
+};
+
+QString compileServerSocketName();
+
+//! Whether this process was started as the compile server
+bool isCompileServer();
+
+//! Main loop of the compile server ; returns the exit code
+int runCompileServer();
+
+/**
+ * @brief Compiles with whatever is available outside of this process.
+ *
+ * Tries the compile server, then the compile workers.
+ * Returns nothing if none of them is enabled.
+ */
+std::optional<CompileResponse> compileOutOfProcess(const CompileRequest& req);
+}
@@ -0,0 +1,135 @@
+#include <JitCpp/CompileStats.hpp>
+
+#include <QDebug>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+
+#include <cstdio>
+#endif
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace Jit
+{
+int64_t residentMemory() noexcept
+{
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS pmc{};
+  if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return pmc.WorkingSetSize;
+  return 0;
+#elif defined(__APPLE__)
+  mach_task_basic_info info{};
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(
+          mach_task_self(),
+          MACH_TASK_BASIC_INFO,
+          reinterpret_cast<task_info_t>(&info),
+          &count)
+      == KERN_SUCCESS)
+    return info.resident_size;
+  return 0;
+#else
+  long pages{}, resident{};
+  if (auto f = std::fopen("/proc/self/statm", "r"))
+  {
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+    std::fclose(f);
+  }
+  return int64_t(resident) * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void releaseFreeMemory() noexcept
+{
+#if defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+}
+
+CompileStatistics& CompileStatistics::instance()
+{
+  static CompileStatistics stats;
+  return stats;
+}
+
+void CompileStatistics::record(CompileStats stats)
+{
+  qDebug() << "JIT compile:" << stats.file.c_str() << stats.milliseconds
+           << "ms, RSS" << (stats.rssAfter / 1024) << "kB ("
+           << (stats.rssDelta() / 1024) << "kB)";
+
+  std::lock_guard lck{m_mutex};
+  m_totalRssGrowth += stats.rssDelta();
+  m_count++;
+  m_history.push_back(std::move(stats));
+  if (m_history.size() > maxHistory)
+    m_history.pop_front();
+}
+
+std::vector<CompileStats> CompileStatistics::history() const
+{
+  std::lock_guard lck{m_mutex};
+  return {m_history.begin(), m_history.end()};
+}
+
+int64_t CompileStatistics::totalRssGrowth() const
+{
+  std::lock_guard lck{m_mutex};
+  return m_totalRssGrowth;
+}
+
+int64_t CompileStatistics::compileCount() const
+{
+  std::lock_guard lck{m_mutex};
+  return m_count;
+}
+
+void CompileStatistics::recordBuild(double milliseconds)
+{
+  qDebug() << "JIT build:" << milliseconds << "ms";
+
+  std::lock_guard lck{m_mutex};
+  m_lastBuild = milliseconds;
+  m_buildCount++;
+}
+
+double CompileStatistics::lastBuildMilliseconds() const
+{
+  std::lock_guard lck{m_mutex};
+  return m_lastBuild;
+}
+
+int64_t CompileStatistics::buildCount() const
+{
+  std::lock_guard lck{m_mutex};
+  return m_buildCount;
+}
+
+void CompileStatistics::recordCacheLookup(bool hit)
+{
+  std::lock_guard lck{m_mutex};
+  (hit ? m_cacheHits : m_cacheMisses)++;
+}
+
+int64_t CompileStatistics::cacheHits() const
+{
+  std::lock_guard lck{m_mutex};
+  return m_cacheHits;
+}
+
+int64_t CompileStatistics::cacheMisses() const
+{
+  std::lock_guard lck{m_mutex};
+  return m_cacheMisses;
+}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <score_addon_jit_export.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Jit
+{
+//! Resident set size of the process in bytes, or 0 if unknown
+SCORE_ADDON_JIT_EXPORT int64_t residentMemory() noexcept;
+
+//! Returns the memory freed by the compiler to the system, when the
+//! allocator keeps it otherwise (glibc)
+SCORE_ADDON_JIT_EXPORT void releaseFreeMemory() noexcept;
+
+struct CompileStats
+{
+  std::string file;
+  double milliseconds{};
+  int64_t rssBefore{};
+  int64_t rssAfter{};
+
+  int64_t rssDelta() const noexcept { return rssAfter - rssBefore; }
+};
+
+/**
+ * @brief Statistics of the latest in-process compilations.
+ *
+ * Used to check that the memory of the process stays bounded
+ * across recompilations.
+ */
+class SCORE_ADDON_JIT_EXPORT CompileStatistics
+{
+public:
+  static CompileStatistics& instance();
+
+  void record(CompileStats stats);
+
+  std::vector<CompileStats> history() const;
+
+  //! Sum of the RSS deltas of every compile since startup
+  int64_t totalRssGrowth() const;
+  int64_t compileCount() const;
+
+  //! Complete builds of a script or addon, from source to entry point
+  void recordBuild(double milliseconds);
+  double lastBuildMilliseconds() const;
+  int64_t buildCount() const;
+
+  void recordCacheLookup(bool hit);
+  int64_t cacheHits() const;
+  int64_t cacheMisses() const;
+
+private:
+  static constexpr std::size_t maxHistory = 256;
+
+  mutable std::mutex m_mutex;
+  std::deque<CompileStats> m_history;
+  int64_t m_totalRssGrowth{};
+  int64_t m_count{};
+
+  double m_lastBuild{};
+  int64_t m_buildCount{};
+  int64_t m_cacheHits{};
+  int64_t m_cacheMisses{};
+};
+}
@@ -0,0 +1,371 @@
+#include <JitCpp/CompileWorker.hpp>
+#include <JitCpp/ClangDriver.hpp>
+#include <JitCpp/Compiler/RealtimeCheck.hpp>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QtEndian>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace Jit
+{
+static constexpr quint32 protocolMagic = 0x32494a53; // "SJI2"
+
+// Bounds of what a corrupt stream can make us allocate
+static constexpr quint32 maxStringSize = 512 * 1024 * 1024;
+static constexpr quint32 maxCount = 65536;
+
+int compileTimeout() noexcept
+{
+  static const int timeout = [] {
+    bool ok{};
+    const int s = qEnvironmentVariableIntValue("SCORE_JIT_COMPILE_TIMEOUT", &ok);
+    return (ok && s > 0 ? s : 300) * 1000;
+  }();
+  return timeout;
+}
+
+static void writeU32(QIODevice& dev, quint32 v)
+{
+  v = qToLittleEndian(v);
+  dev.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+static void writeString(QIODevice& dev, const std::string& str)
+{
+  writeU32(dev, str.size());
+  dev.write(str.data(), str.size());
+}
+
+//! Blocks until n bytes are read, for processes, sockets and files alike ;
+//! fails when nothing came for msecs
+static bool readExactly(QIODevice& dev, char* data, qint64 n, int msecs)
+{
+  while (n > 0)
+  {
+    auto r = dev.read(data, n);
+    if (r < 0)
+      return false;
+    if (r == 0 && !dev.waitForReadyRead(msecs))
+    {
+      // Files such as stdin do not support waitForReadyRead
+      r = dev.read(data, n);
+      if (r <= 0)
+        return false;
+    }
+    data += r;
+    n -= r;
+  }
+  return true;
+}
+
+static bool readU32(QIODevice& dev, quint32& v, int msecs)
+{
+  if (!readExactly(dev, reinterpret_cast<char*>(&v), sizeof(v), msecs))
+    return false;
+  v = qFromLittleEndian(v);
+  return true;
+}
+
+static bool readCount(QIODevice& dev, quint32& count, int msecs)
+{
+  return readU32(dev, count, msecs) && count <= maxCount;
+}
+
+static bool readString(QIODevice& dev, std::string& str, int msecs)
+{
+  quint32 sz{};
+  if (!readU32(dev, sz, msecs) || sz > maxStringSize)
+    return false;
+  str.resize(sz);
+  return readExactly(dev, str.data(), sz, msecs);
+}
+
+static void flush(QIODevice& dev)
+{
+  if (auto proc = qobject_cast<QProcess*>(&dev))
+    proc->waitForBytesWritten(-1);
+  else if (auto file = qobject_cast<QFile*>(&dev))
+    file->flush();
+  else
+    dev.waitForBytesWritten(-1);
+}
+
+void writeRequest(QIODevice& dev, const CompileRequest& req)
+{
+  writeU32(dev, protocolMagic);
+  writeU32(dev, req.args.size());
+  for (const auto& arg : req.args)
+    writeString(dev, arg);
+  writeString(dev, req.source);
+  writeU32(dev, req.realtimeCheck);
+  flush(dev);
+}
+
+bool readRequest(QIODevice& dev, CompileRequest& req)
+{
+  // Workers and the server wait for their next request as long as needed
+  quint32 magic{}, count{};
+  if (!readU32(dev, magic, -1) || magic != protocolMagic)
+    return false;
+  if (!readCount(dev, count, -1))
+    return false;
+
+  req.args.resize(count);
+  for (auto& arg : req.args)
+    if (!readString(dev, arg, -1))
+      return false;
+
+  quint32 check{};
+  if (!readString(dev, req.source, -1) || !readU32(dev, check, -1))
+    return false;
+  req.realtimeCheck = check;
+  return true;
+}
+
+void writeResponse(QIODevice& dev, const CompileResponse& res)
+{
+  writeU32(dev, protocolMagic);
+  writeU32(dev, res.ok);
+  writeString(dev, res.diagnostics);
+  writeString(dev, res.object);
+  writeU32(dev, res.dependencies.size());
+  for (const auto& dep : res.dependencies)
+    writeString(dev, dep);
+  writeU32(dev, res.remarks.size());
+  for (const auto& remark : res.remarks)
+  {
+    writeU32(dev, remark.line);
+    writeString(dev, remark.kind);
+    writeString(dev, remark.message);
+  }
+  flush(dev);
+}
+
+bool readResponse(QIODevice& dev, CompileResponse& res, int msecs)
+{
+  quint32 magic{}, ok{};
+  if (!readU32(dev, magic, msecs) || magic != protocolMagic)
+    return false;
+  if (!readU32(dev, ok, msecs))
+    return false;
+  res.ok = ok;
+  if (!readString(dev, res.diagnostics, msecs)
+      || !readString(dev, res.object, msecs))
+    return false;
+
+  quint32 count{};
+  if (!readCount(dev, count, msecs))
+    return false;
+  res.dependencies.resize(count);
+  for (auto& dep : res.dependencies)
+    if (!readString(dev, dep, msecs))
+      return false;
+
+  if (!readCount(dev, count, msecs))
+    return false;
+  res.remarks.resize(count);
+  for (auto& remark : res.remarks)
+  {
+    quint32 line{};
+    if (!readU32(dev, line, msecs) || !readString(dev, remark.kind, msecs)
+        || !readString(dev, remark.message, msecs))
+      return false;
+    remark.line = line;
+  }
+  return true;
+}
+
+//! Generates the object of a module as the JIT does for in-process builds
+static llvm::Expected<std::string> emitObject(llvm::Module& m)
+{
+  auto builder = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!builder)
+    return builder.takeError();
+  auto tm = builder->createTargetMachine();
+  if (!tm)
+    return tm.takeError();
+
+#if LLVM_VERSION_MAJOR >= 18
+  const auto type = llvm::CodeGenFileType::ObjectFile;
+#elif LLVM_VERSION_MAJOR >= 10
+  const auto type = llvm::CGFT_ObjectFile;
+#else
+  const auto type = llvm::TargetMachine::CGFT_ObjectFile;
+#endif
+
+  m.setDataLayout((*tm)->createDataLayout());
+  llvm::SmallVector<char, 0> obj;
+  llvm::raw_svector_ostream os{obj};
+  llvm::legacy::PassManager passes;
+  if ((*tm)->addPassesToEmitFile(passes, os, nullptr, type))
+    return llvm::createStringError(
+        llvm::inconvertibleErrorCode(), "Cannot emit an object file");
+  passes.run(m);
+  return std::string(obj.data(), obj.size());
+}
+
+//! The real-time check needs the IR: clang then emits bitcode, which is
+//! checked and turned into the object here
+static void checkAndEmitObject(const std::string& bc, CompileResponse& res)
+{
+  llvm::LLVMContext context;
+  auto module = readModuleFromBitcodeFile(bc, context);
+  if (!module)
+  {
+    res.diagnostics = llvm::toString(module.takeError());
+    return;
+  }
+
+  auto unsafe = checkRealtimeSafety(**module);
+  res.remarks.insert(res.remarks.end(), unsafe.begin(), unsafe.end());
+
+  auto obj = emitObject(**module);
+  if (!obj)
+  {
+    res.diagnostics = llvm::toString(obj.takeError());
+    return;
+  }
+  res.object = std::move(*obj);
+  res.ok = true;
+}
+
+CompileResponse compileRequest(const CompileRequest& req)
+{
+  CompileResponse res;
+  auto src = saveSourceFile(req.source);
+  if (!src)
+  {
+    res.diagnostics = llvm::toString(src.takeError());
+    return res;
+  }
+
+  // See ClangCC1Driver::getObjectArgs
+  auto args = req.args;
+  const bool check = req.realtimeCheck && !args.empty()
+                     && args.front() == "-emit-obj";
+  if (check)
+  {
+    args.erase(args.begin());
+    args.insert(
+        args.begin(), {"-emit-llvm", "-emit-llvm-bc", "-emit-llvm-uselists"});
+  }
+
+  const auto out = replaceExtension(*src, check ? "bc" : "o");
+  const auto deps = ClangCC1Driver::dependencyArgs(*src);
+  args.insert(args.end(), deps.begin(), deps.end());
+  args.insert(args.end(), {"-main-file-name", *src, "-o", out, *src});
+
+  auto err = ClangCC1Driver::compileCppToBitcodeFile(args, &res.remarks);
+  res.dependencies = ClangCC1Driver::readDependencies(*src);
+  if (err)
+  {
+    res.diagnostics = llvm::toString(std::move(err));
+  }
+  else if (check)
+  {
+    checkAndEmitObject(out, res);
+  }
+  else if (auto buf = llvm::MemoryBuffer::getFile(out))
+  {
+    res.object = (*buf)->getBuffer().str();
+    res.ok = true;
+  }
+  else
+  {
+    res.diagnostics = buf.getError().message();
+  }
+
+  llvm::sys::fs::remove(out);
+  llvm::sys::fs::remove(*src);
+  return res;
+}
+
+CompileWorkerPool& CompileWorkerPool::instance()
+{
+  static CompileWorkerPool pool;
+  return pool;
+}
+
+CompileWorkerPool::CompileWorkerPool()
+    : m_count{qEnvironmentVariableIntValue("SCORE_JIT_WORKERS")}
+{
+  if (isCompileWorker())
+    m_count = 0;
+}
+
+std::optional<CompileResponse>
+CompileWorkerPool::compile(const CompileRequest& req)
+{
+  // QProcess has thread affinity: each compile thread owns its worker
+  thread_local std::unique_ptr<QProcess> worker;
+  if (!worker || worker->state() != QProcess::Running)
+  {
+    worker = std::make_unique<QProcess>();
+    auto env = QProcessEnvironment::systemEnvironment();
+    env.insert("SCORE_JIT_WORKER", "1");
+    env.remove("SCORE_JIT_WORKERS");
+    worker->setProcessEnvironment(env);
+    worker->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    worker->start(QCoreApplication::applicationFilePath(), {"--no-gui"});
+    if (!worker->waitForStarted())
+    {
+      qDebug() << "Could not start a JIT compile worker";
+      worker.reset();
+      return std::nullopt;
+    }
+  }
+
+  writeRequest(*worker, req);
+
+  // A crashed or hung worker: the caller builds in-process instead
+  CompileResponse res;
+  if (!readResponse(*worker, res, compileTimeout()))
+  {
+    qDebug() << "The JIT compile worker stopped or timed out";
+    worker->kill();
+    worker->waitForFinished();
+    worker.reset();
+    return std::nullopt;
+  }
+
+  return res;
+}
+
+bool isCompileWorker()
+{
+  return qEnvironmentVariableIsSet("SCORE_JIT_WORKER");
+}
+
+int runCompileWorker()
+{
+  QFile in, out;
+  in.open(stdin, QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+#if !defined(_WIN32)
+  // Anything printed on stdout by the compiler would corrupt the protocol:
+  // keep our own handle to it and send the rest to stderr.
+  const int fd = ::dup(STDOUT_FILENO);
+  ::dup2(STDERR_FILENO, STDOUT_FILENO);
+  out.open(fd, QIODevice::WriteOnly | QIODevice::Unbuffered);
+#else
+  out.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+#endif
+
+  CompileRequest req;
+  while (readRequest(in, req))
+    writeResponse(out, compileRequest(req));
+
+  return 0;
+}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <JitCpp/JitUtils.hpp>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <QIODevice>
+
+#include <score_addon_jit_export.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Jit
+{
+//! A C++ source and the complete cc1 arguments to build it to an object
+struct CompileRequest
+{
+  std::vector<std::string> args;
+  std::string source;
+
+  //! Run RealtimeSafetyPass on the IR, the findings go in the remarks
+  bool realtimeCheck{};
+};
+
+struct CompileResponse
+{
+  bool ok{};
+  std::string diagnostics;
+  std::string object;
+
+  //! Files included by the compilation, for the object cache manifest
+  std::vector<std::string> dependencies;
+
+  std::vector<CompileRemark> remarks;
+};
+
+/**
+ * @brief Pool of compile worker processes.
+ *
+ * Workers are instances of the score executable started with
+ * SCORE_JIT_WORKER=1 in their environment: they receive compile requests on
+ * their standard input and answer with the object files on their standard
+ * output. clang thus never runs in the score process, which keeps its heap
+ * from growing with each compilation, and allows compiling in parallel.
+ *
+ * Enabled by setting SCORE_JIT_WORKERS to the number of workers.
+ * Each compile thread talks to its own worker.
+ */
+class SCORE_ADDON_JIT_EXPORT CompileWorkerPool
+{
+public:
+  static CompileWorkerPool& instance();
+
+  bool enabled() const noexcept { return m_count > 0; }
+  int count() const noexcept { return m_count; }
+
+  //! Compiles with the worker of the calling thread, starting it if needed ;
+  //! nullopt if the worker stopped or hung, it is then killed
+  std::optional<CompileResponse> compile(const CompileRequest& req);
+
+private:
+  CompileWorkerPool();
+  int m_count{};
+};
+
+//! Whether this process was started as a compile worker
+bool isCompileWorker();
+
+//! Main loop of a worker process ; returns the exit code
+int runCompileWorker();
+
+//! From SCORE_JIT_COMPILE_TIMEOUT, in seconds (300 by default) ; how long a
+//! worker or the server may take to answer, in milliseconds
+int compileTimeout() noexcept;
+
+// Wire format shared by the workers and the compile server ; the reads
+// fail after msecs without data, -1 waits forever
+void writeRequest(QIODevice& dev, const CompileRequest& req);
+bool readRequest(QIODevice& dev, CompileRequest& req);
+void writeResponse(QIODevice& dev, const CompileResponse& res);
+bool readResponse(QIODevice& dev, CompileResponse& res, int msecs = -1);
+
+//! Runs the request with the in-process clang
+CompileResponse compileRequest(const CompileRequest& req);
+}
@@ -1,9 +1,18 @@
 #pragma once
 #include <JitCpp/ClangDriver.hpp>
+#include <JitCpp/Compiler/ObjectCache.hpp>
+#include <JitCpp/CompileServer.hpp>
+#include <JitCpp/CompileStats.hpp>
+#include <JitCpp/FunctionTrace.hpp>
+#include <JitCpp/JitMemory.hpp>
+#include <JitCpp/JitPlatform.hpp>
+#include <JitCpp/RealtimeArena.hpp>
 #include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 
 #include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
 
 #include <QDebug>
 namespace Jit
@@ -12,13 +21,22 @@ class JitCompiler
 {
   using ModulePtr_t = std::unique_ptr<llvm::Module>;
 public:
-  JitCompiler(llvm::TargetMachine& targetMachine)
+  //! arenaSize: when not 0, malloc & new in the JIT'd code are interposed
+  //! with a RealtimeArena of that size
+  JitCompiler(
+      llvm::TargetMachine& targetMachine,
+      std::shared_ptr<JitMemoryUsage> memory,
+      std::size_t arenaSize = 0)
+      : m_memory{std::move(memory)}
   {
     using namespace llvm;
     using namespace llvm::orc;
     // Load own executable as dynamic library.
     // Required for RTDyldMemoryManager::getSymbolAddressInProcess().
     sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+    // Objects from the cache may call _ZGV* functions without any compile
+    // having loaded the library first
+    vectorMathLibrary();
 
     LLJIT& JIT = *m_jit;
 
@@ -27,6 +45,31 @@ public:
       // auto s = absoluteSymbols({ { Mangle("atexit"), JITEvaluatedSymbol(pointerToJITTargetAddress(&atexit), JITSymbolFlags::Exported)}});
       // JD.define(std::move(s));
     }
+    if (arenaSize > 0)
+    {
+      // Looked up before the process' own allocator by the generator below
+      m_arena = std::make_unique<RealtimeArena>(arenaSize, m_memory);
+      SymbolMap symbols;
+      for (auto& [name, address] : arenaSymbols())
+        symbols[m_mangler(name)] = JITEvaluatedSymbol(
+            pointerToJITTargetAddress(address), JITSymbolFlags::Exported);
+      if (auto Err = JD.define(absoluteSymbols(std::move(symbols))))
+        llvm::consumeError(std::move(Err));
+    }
+    {
+      // Hooks of -finstrument-functions-after-inlining
+      auto s = absoluteSymbols(
+          {{m_mangler("__cyg_profile_func_enter"),
+            JITEvaluatedSymbol(
+                pointerToJITTargetAddress(&score_jit_trace_enter),
+                JITSymbolFlags::Exported)},
+           {m_mangler("__cyg_profile_func_exit"),
+            JITEvaluatedSymbol(
+                pointerToJITTargetAddress(&score_jit_trace_exit),
+                JITSymbolFlags::Exported)}});
+      if (auto Err = JD.define(std::move(s)))
+        llvm::consumeError(std::move(Err));
+    }
     {
       auto gen =
           DynamicLibrarySearchGenerator::GetForCurrentProcess(
@@ -56,26 +99,81 @@ public:
 #endif
   }
 
-  auto compile(
+  //! cacheKey identifies the compilation in the object cache ; see ObjectCache::key
+  ModulePtr_t compile(
       const std::string& cppCode,
       const std::vector<std::string>& flags,
       CompilerOptions opts,
-      llvm::orc::ThreadSafeContext& context)
+      llvm::orc::ThreadSafeContext& context,
+      const std::string& cacheKey = {})
   {
     using namespace llvm;
     using namespace llvm::orc;
+
+    m_remarks.clear();
+    if (!cacheKey.empty())
+    {
+      auto obj = m_cache.load(cacheKey);
+      CompileStatistics::instance().recordCacheLookup(bool(obj));
+      if (obj)
+      {
+        // Reported again, as the build which stored the object did
+        m_remarks = m_cache.remarks(cacheKey);
+        rejectUnsafe(opts);
+
+        if (auto Err = m_jit->addObjectFile(std::move(obj)); bool(Err))
+          throw Exception{std::move(Err)};
+        initialize();
+        return {};
+      }
+    }
+
+    if (CompileServerClient::instance().enabled()
+        || CompileWorkerPool::instance().enabled())
+    {
+      // Out-of-process: we get an object file back, and the findings of
+      // the real-time check in the remarks
+      auto src = llvm::MemoryBuffer::getFile(cppCode);
+      if (!src)
+        throw Exception{llvm::errorCodeToError(src.getError())};
+
+      auto res = compileOutOfProcess(CompileRequest{
+          ClangCC1Driver::getObjectArgs(flags, opts),
+          (*src)->getBuffer().str(),
+          opts.RealtimeCheck});
+
+      // Otherwise neither the server nor the workers were reachable:
+      // build in-process
+      if (res)
+      {
+        if (!res->ok)
+          throw Exception{res->diagnostics};
+        m_remarks = res->remarks;
+        rejectUnsafe(opts);
+
+        auto obj = llvm::MemoryBuffer::getMemBufferCopy(res->object, cacheKey);
+        m_cache.storeDependencies(cacheKey, res->dependencies, m_remarks);
+        m_cache.store(cacheKey, obj->getMemBufferRef());
+        if (auto Err = m_jit->addObjectFile(std::move(obj)); bool(Err))
+          throw Exception{std::move(Err)};
+        initialize();
+        return {};
+      }
+    }
+
     auto module = m_driver.compileTranslationUnit(cppCode, flags, opts, *context.getContext());
     if (!module)
       throw Exception{module.takeError()};
 
+    // The object cache names its files after the module identifier
+    (*module)->setModuleIdentifier(cacheKey);
+    m_remarks = m_driver.remarks();
+    m_cache.storeDependencies(cacheKey, m_driver.dependencies(), m_remarks);
+
     if (auto Err = m_jit->addIRModule(ThreadSafeModule(std::move(*module), context)); bool(Err))
-      throw Err;
+      throw Exception{std::move(Err)};
 
-#if LLVM_VERSION_MAJOR >= 11
-    m_jit->initialize(m_jit->getMainJITDylib());
-#else
-    m_jit->runConstructors();
-#endif
+    initialize();
     return std::move(*module);
   }
 
@@ -93,11 +191,104 @@ public:
     return std::function<Signature_t>(Entry);
   }
 
+  //! Address of an optional symbol, e.g. a constant declared by a script ;
+  //! nullptr if it is not defined
+  template <class T>
+  T* getSymbol(std::string name)
+  {
+    auto Sym = m_jit->lookup(name);
+    if (!Sym)
+    {
+      llvm::consumeError(Sym.takeError());
+      return nullptr;
+    }
+    return (T*)Sym->getAddress();
+  }
+
+  //! nullptr unless built with an arena size
+  RealtimeArena* arena() const noexcept { return m_arena.get(); }
+
+  //! Remarks of the last compile ; for a cached object, those of the build
+  //! which stored it
+  const std::vector<CompileRemark>& remarks() const noexcept
+  {
+    return m_remarks;
+  }
+
 private:
+  //! Strict mode refuses the code flagged by the real-time check ;
+  //! in-process builds do so in ClangCC1Driver::compileTranslationUnit
+  void rejectUnsafe(const CompilerOptions& opts) const
+  {
+    if (!opts.RealtimeStrict)
+      return;
+
+    std::vector<CompileRemark> unsafe;
+    for (const auto& r : m_remarks)
+      if (r.kind == "realtime")
+        unsafe.push_back(r);
+    if (!unsafe.empty())
+      throw Exception{
+          "error : the audio code is not real-time safe\n"
+          + remarksMessage(unsafe).second};
+  }
+
+  void initialize()
+  {
+#if LLVM_VERSION_MAJOR >= 11
+    m_jit->initialize(m_jit->getMainJITDylib());
+#else
+    m_jit->runConstructors();
+#endif
+  }
+
+  std::unique_ptr<llvm::orc::LLJIT> createJit()
+  {
+    using namespace llvm;
+    using namespace llvm::orc;
+    LLJITBuilder builder;
+#if LLVM_VERSION_MAJOR >= 11
+    builder.setCompileFunctionCreator(
+        [this](JITTargetMachineBuilder JTMB)
+            -> Expected<std::unique_ptr<IRCompileLayer::IRCompiler>> {
+          auto TM = JTMB.createTargetMachine();
+          if (!TM)
+            return TM.takeError();
+          return std::make_unique<TMOwningSimpleCompiler>(
+              std::move(*TM), &m_cache);
+        });
+
+    // Counts the memory of the loaded objects, and registers the names of
+    // the JIT'd functions for the traces
+    builder.setObjectLinkingLayerCreator(
+        [this](ExecutionSession& ES, const Triple& TT)
+            -> Expected<std::unique_ptr<ObjectLayer>> {
+          auto layer = std::make_unique<RTDyldObjectLinkingLayer>(
+              ES, [mem = m_memory] {
+                return std::make_unique<JitMemoryManager>(mem);
+              });
+          if (TT.isOSBinFormatCOFF())
+          {
+            layer->setOverrideObjectFlagsWithResponsibilityFlags(true);
+            layer->setAutoClaimResponsibilityForObjectSymbols(true);
+          }
+          layer->registerJITEventListener(m_symbols);
+          return std::move(layer);
+        });
+#endif
+    return std::move(builder.create().get());
+  }
+
+  ObjectCache m_cache;
+  std::shared_ptr<JitMemoryUsage> m_memory;
+  // Outlives the JIT'd code, whose destructors may still free its blocks
+  std::unique_ptr<RealtimeArena> m_arena;
+  TraceSymbolListener m_symbols;
   ClangCC1Driver m_driver;
-  std::unique_ptr<llvm::orc::LLJIT> m_jit{std::move(llvm::orc::LLJITBuilder().create().get())};
+  std::unique_ptr<llvm::orc::LLJIT> m_jit{createJit()};
 
   const llvm::DataLayout &m_dl{m_jit->getDataLayout()};
   llvm::orc::MangleAndInterner m_mangler{m_jit->getExecutionSession(), m_dl};
+  std::vector<CompileRemark> m_remarks;
 };
 }
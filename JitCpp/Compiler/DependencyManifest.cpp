@@ -0,0 +1,218 @@
+#include <JitCpp/Compiler/DependencyManifest.hpp>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+namespace Jit
+{
+// 2: with the remarks
+static constexpr int manifestVersion = 2;
+
+std::vector<std::string> readDependencyFile(const std::string& path)
+{
+  std::vector<std::string> deps;
+  QFile f{QString::fromStdString(path)};
+  if (!f.open(QIODevice::ReadOnly))
+    return deps;
+
+  const auto content = f.readAll().toStdString();
+
+  // Skip the target
+  auto colon = content.find(": ");
+  if (colon == std::string::npos)
+    return deps;
+
+  std::string cur;
+  for (std::size_t i = colon + 2; i < content.size(); i++)
+  {
+    const char c = content[i];
+    if (c == '\\' && i + 1 < content.size())
+    {
+      const char next = content[i + 1];
+      if (next == '\n' || next == '\r')
+      {
+        // Line continuation
+        i++;
+        continue;
+      }
+      if (next == ' ' || next == '#' || next == '\\')
+      {
+        cur += next;
+        i++;
+        continue;
+      }
+    }
+    if (c == '$' && i + 1 < content.size() && content[i + 1] == '$')
+    {
+      cur += '$';
+      i++;
+      continue;
+    }
+
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+    {
+      if (!cur.empty())
+        deps.push_back(std::move(cur));
+      cur.clear();
+    }
+    else
+    {
+      cur += c;
+    }
+  }
+
+  if (!cur.empty())
+    deps.push_back(std::move(cur));
+  return deps;
+}
+
+static QString hashFile(const QString& path)
+{
+  QFile f{path};
+  if (!f.open(QIODevice::ReadOnly))
+    return {};
+
+  QCryptographicHash hash{QCryptographicHash::Sha1};
+  hash.addData(&f);
+  return QString::fromLatin1(hash.result().toHex());
+}
+
+static QJsonObject fileEntry(const QFileInfo& fi, const QString& hash)
+{
+  return QJsonObject{
+      {"Path", fi.absoluteFilePath()},
+      {"Size", fi.size()},
+      {"MTime", fi.lastModified().toMSecsSinceEpoch()},
+      {"Hash", hash}};
+}
+
+static bool saveManifest(const QString& path, const QJsonObject& obj)
+{
+  QSaveFile f{path};
+  if (!f.open(QIODevice::WriteOnly))
+    return false;
+  f.write(QJsonDocument{obj}.toJson(QJsonDocument::Compact));
+  return f.commit();
+}
+
+bool DependencyManifest::write(
+    const std::string& path,
+    const std::string& key,
+    const std::vector<std::string>& files,
+    const std::vector<CompileRemark>& remarks)
+{
+  QJsonArray entries;
+  for (const auto& file : files)
+  {
+    QFileInfo fi{QString::fromStdString(file)};
+    const auto hash = hashFile(fi.absoluteFilePath());
+    if (hash.isEmpty())
+      return false;
+    entries.push_back(fileEntry(fi, hash));
+  }
+
+  QJsonArray remarkEntries;
+  for (const auto& r : remarks)
+  {
+    remarkEntries.push_back(QJsonObject{
+        {"Line", r.line},
+        {"Kind", QString::fromStdString(r.kind)},
+        {"Message", QString::fromStdString(r.message)}});
+  }
+
+  return saveManifest(
+      QString::fromStdString(path),
+      QJsonObject{
+          {"Version", manifestVersion},
+          {"Key", QString::fromStdString(key)},
+          {"Files", entries},
+          {"Remarks", remarkEntries}});
+}
+
+bool DependencyManifest::validate(const std::string& path, const std::string& key)
+{
+  QFile f{QString::fromStdString(path)};
+  if (!f.open(QIODevice::ReadOnly))
+    return false;
+
+  auto obj = QJsonDocument::fromJson(f.readAll()).object();
+  f.close();
+  if (obj["Version"].toInt() != manifestVersion
+      || obj["Key"].toString().toStdString() != key)
+    return false;
+
+  auto entries = obj["Files"].toArray();
+  bool touched = false;
+  for (int i = 0; i < entries.size(); i++)
+  {
+    const auto entry = entries[i].toObject();
+    const QFileInfo fi{entry["Path"].toString()};
+    if (!fi.exists() || fi.size() != entry["Size"].toVariant().toLongLong())
+      return false;
+
+    if (fi.lastModified().toMSecsSinceEpoch()
+        != entry["MTime"].toVariant().toLongLong())
+    {
+      // Touched but maybe not modified: compare the contents
+      const auto hash = hashFile(fi.absoluteFilePath());
+      if (hash != entry["Hash"].toString())
+      {
+        qDebug() << "JIT object cache: stale, " << fi.absoluteFilePath()
+                 << "changed";
+        return false;
+      }
+      entries[i] = fileEntry(fi, hash);
+      touched = true;
+    }
+  }
+
+  // Next time the stat calls will be enough again
+  if (touched)
+  {
+    obj["Files"] = entries;
+    saveManifest(QString::fromStdString(path), obj);
+  }
+  return true;
+}
+
+std::vector<std::string> DependencyManifest::files(const std::string& path)
+{
+  std::vector<std::string> res;
+  QFile f{QString::fromStdString(path)};
+  if (!f.open(QIODevice::ReadOnly))
+    return res;
+
+  const auto entries
+      = QJsonDocument::fromJson(f.readAll()).object()["Files"].toArray();
+  for (const auto& entry : entries)
+    res.push_back(entry.toObject()["Path"].toString().toStdString());
+  return res;
+}
+
+std::vector<CompileRemark> DependencyManifest::remarks(const std::string& path)
+{
+  std::vector<CompileRemark> res;
+  QFile f{QString::fromStdString(path)};
+  if (!f.open(QIODevice::ReadOnly))
+    return res;
+
+  const auto entries
+      = QJsonDocument::fromJson(f.readAll()).object()["Remarks"].toArray();
+  for (const auto& entry : entries)
+  {
+    const auto obj = entry.toObject();
+    res.push_back(CompileRemark{
+        obj["Line"].toInt(),
+        obj["Kind"].toString().toStdString(),
+        obj["Message"].toString().toStdString()});
+  }
+  return res;
+}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <JitCpp/JitUtils.hpp>
+
+#include <score_addon_jit_export.h>
+
+#include <string>
+#include <vector>
+
+namespace Jit
+{
+//! Parses a Makefile-style dependency file, as written by clang
+//! with -dependency-file
+SCORE_ADDON_JIT_EXPORT
+std::vector<std::string> readDependencyFile(const std::string& path);
+
+/**
+ * @brief Files which went into a cached object.
+ *
+ * Stored next to each object of the cache with the path, size, mtime and
+ * content hash of every file the compilation included, as ccache does in
+ * its direct mode : an entry is validated with a stat call per file,
+ * without running the preprocessor again. The content of a file is only
+ * hashed again when its mtime changed while its size did not.
+ *
+ * The remarks of the compilation are kept with it, so that a cache hit
+ * reports the same ones as the build it comes from.
+ */
+class SCORE_ADDON_JIT_EXPORT DependencyManifest
+{
+public:
+  static bool write(
+      const std::string& path,
+      const std::string& key,
+      const std::vector<std::string>& files,
+      const std::vector<CompileRemark>& remarks = {});
+
+  //! Whether every file is still as it was when the object was built
+  static bool validate(const std::string& path, const std::string& key);
+
+  static std::vector<std::string> files(const std::string& path);
+  static std::vector<CompileRemark> remarks(const std::string& path);
+};
+}
@@ -1,18 +1,30 @@
 #pragma once
 #include <JitCpp/Compiler/Compiler.hpp>
+#include <JitCpp/CompileScheduler.hpp>
+#include <JitCpp/CompileStats.hpp>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/Support/PrettyStackTrace.h>
 
+#include <thread>
+
 namespace Jit
 {
 
 template <typename Fun_T>
 struct Driver
 {
-  Driver(const std::string& fname)
-      : X{0, nullptr}
-      , ts_ctx{std::make_unique<llvm::LLVMContext>()}
-      , jit{*llvm::EngineBuilder().selectTarget()}
+  //! label and owner (e.g. the process) identify the build in JitMemory ;
+  //! arena is the size of the RealtimeArena of the build, 0 for none
+  Driver(
+      const std::string& fname,
+      const QString& label = {},
+      const void* owner = nullptr,
+      std::size_t arena = 0)
+      : ts_ctx{std::make_unique<llvm::LLVMContext>()}
+      , memory{JitMemory::instance().create(
+            label.isEmpty() ? QString::fromStdString(fname) : label,
+            owner)}
+      , jit{*llvm::EngineBuilder().selectTarget(), memory, arena}
       , factory_name{fname}
   {
   }
@@ -20,10 +32,23 @@ struct Driver
   std::function<Fun_T> operator()(
       const std::string& sourceCode,
       const std::vector<std::string>& flags,
-      CompilerOptions opts)
+      CompilerOptions opts,
+      const CancellationToken& cancelled = {})
   {
+    // Called between the compilation stages, as clang itself cannot be
+    // interrupted
+    auto checkCancelled = [&] {
+      if (cancelled && *cancelled)
+        throw Exception{"Compilation cancelled"};
+    };
+
+    // Stack trace entries are per-thread and popped in LIFO order: one per
+    // build, on the stack, rather than one per driver
+    llvm::PrettyStackTraceProgram X{0, nullptr};
+
     auto t0 = std::chrono::high_resolution_clock::now();
 
+    const auto cacheKey = ObjectCache::key(sourceCode, flags, opts);
     auto sourceFileName = saveSourceFile(sourceCode);
     if (!sourceFileName)
       return {};
@@ -31,27 +56,76 @@ struct Driver
     std::string cpp = *sourceFileName;
     auto filename = QFileInfo(QString::fromStdString(cpp)).fileName();
 
-    auto module = jit.compile(cpp, flags, opts, ts_ctx);
-    auto t1 = std::chrono::high_resolution_clock::now();
+    checkCancelled();
+    const auto rss0 = residentMemory();
+    auto module = jit.compile(cpp, flags, opts, ts_ctx, cacheKey);
+
+    // Looking the function up is what triggers code generation
+    checkCancelled();
 
     auto jitedFn = jit.getFunction<Fun_T>(factory_name);
     if (!jitedFn)
       throw Exception{jitedFn.takeError()};
 
-    llvm::outs().flush();
-    std::cerr << "\n\nADDON BUILD DURATION: "
-              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0)
-                     .count()
-              << " ms \n\n";
+    memory->rssDelta += residentMemory() - rss0;
+    memory->builds++;
+
+    // Includes the code generation and the store in the object cache
+    auto t1 = std::chrono::high_resolution_clock::now();
+    CompileStatistics::instance().recordBuild(
+        std::chrono::duration<double, std::milli>(t1 - t0).count());
 
     return *jitedFn;
   }
 
-  llvm::PrettyStackTraceProgram X;
-  llvm::LLVMContext context;
+  //! Optimization remarks of the last build, see
+  //! CompilerOptions::OptimizationRemarks
+  const std::vector<CompileRemark>& remarks() const noexcept
+  {
+    return jit.remarks();
+  }
+
+  //! Looks up another entry point with the same signature in what was
+  //! compiled, e.g. in batched builds
+  std::function<Fun_T> function(const std::string& name)
+  {
+    auto jitedFn = jit.getFunction<Fun_T>(name);
+    if (!jitedFn)
+      throw Exception{jitedFn.takeError()};
+    return *jitedFn;
+  }
+
+  //! To activate with a ScopedArena around the calls, nullptr if none
+  RealtimeArena* arena() const noexcept { return jit.arena(); }
+
+  //! Looks up an optional symbol of any type, nullptr if not defined
+  template <typename T>
+  T* symbol(const std::string& name)
+  {
+    return jit.template getSymbol<T>(name);
+  }
+
   llvm::orc::ThreadSafeContext ts_ctx;
+  std::shared_ptr<JitMemoryUsage> memory;
   JitCompiler jit;
   std::string factory_name;
 };
 
+/**
+ * @brief Creates a driver destroyed on the thread which built it.
+ *
+ * Drivers are built on a compile thread and released by the GUI thread:
+ * the JIT'd code is deinitialized and its memory freed where it was
+ * compiled, see CompileScheduler::destroyOn.
+ */
+template <typename Driver_T, typename... Args>
+std::shared_ptr<Driver_T> makeDriver(Args&&... args)
+{
+  return std::shared_ptr<Driver_T>(
+      new Driver_T(std::forward<Args>(args)...),
+      [thread = std::this_thread::get_id()](Driver_T* d) {
+        CompileScheduler::instance().destroyOn(thread, [d] { delete d; });
+      });
+}
+
 }
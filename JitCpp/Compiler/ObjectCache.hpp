@@ -0,0 +1,180 @@
+#pragma once
+#include <JitCpp/ClangDriver.hpp>
+#include <JitCpp/Compiler/DependencyManifest.hpp>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <QCryptographicHash>
+#include <QDebug>
+
+namespace Jit
+{
+/**
+ * @brief On-disk cache of the objects built by the JIT.
+ *
+ * Objects are stored in ClangCC1Driver::bitcodeDatabase()/objects,
+ * and are named after a hash of everything which went into the compilation
+ * (source, flags, options, LLVM version and host CPU).
+ *
+ * Each object has a manifest of the files its compilation included,
+ * which must be unchanged for the object to be used.
+ *
+ * Loading an object maps the file read-only instead of reading it into
+ * a heap buffer: the linker only touches the pages it actually needs,
+ * and the file pages are shared between every score instance of the host.
+ */
+class ObjectCache final : public llvm::ObjectCache
+{
+public:
+  ObjectCache()
+  {
+    if (auto db = ClangCC1Driver::bitcodeDatabase())
+    {
+      if (db->mkpath("objects"))
+        m_dir = (db->absolutePath() + "/objects").toStdString();
+    }
+  }
+
+  static std::string key(
+      const std::string& source,
+      const std::vector<std::string>& flags,
+      const CompilerOptions& opts)
+  {
+    QCryptographicHash hash{QCryptographicHash::Sha1};
+    hash.addData(source.data(), source.size());
+    for (const auto& flag : flags)
+      hash.addData(flag.data(), flag.size() + 1);
+
+    hash.addData(SCORE_LLVM_VERSION);
+    const auto cpu = llvm::sys::getHostCPUName();
+    hash.addData(cpu.data(), cpu.size());
+    hash.addData((const char*)&opts.NoExceptions, sizeof(opts.NoExceptions));
+    hash.addData((const char*)&opts.TraceFunctions, sizeof(opts.TraceFunctions));
+    hash.addData((const char*)&opts.RealtimeStrict, sizeof(opts.RealtimeStrict));
+    // Both change the remarks stored with the object
+    hash.addData(
+        (const char*)&opts.OptimizationRemarks, sizeof(opts.OptimizationRemarks));
+    hash.addData((const char*)&opts.RealtimeCheck, sizeof(opts.RealtimeCheck));
+    hash.addData((const char*)&opts.VectorMath, sizeof(opts.VectorMath));
+
+    return hash.result().toHex().toStdString();
+  }
+
+  bool enabled() const noexcept { return !m_dir.empty(); }
+
+  std::string path(llvm::StringRef key) const
+  {
+    return m_dir + "/" + key.str() + ".o";
+  }
+
+  std::string manifestPath(llvm::StringRef key) const
+  {
+    return m_dir + "/" + key.str() + ".deps.json";
+  }
+
+  //! Maps a cached object read-only, if there is one and its manifest
+  //! is still valid
+  std::unique_ptr<llvm::MemoryBuffer> load(llvm::StringRef key) const
+  {
+    if (!enabled())
+      return {};
+
+    const auto file = path(key);
+    if (!llvm::sys::fs::exists(file))
+      return {};
+
+    if (!DependencyManifest::validate(manifestPath(key), key.str()))
+    {
+      // An included file changed: the key of the new build is the same, so
+      // the stale object must not be found once its new manifest is written
+      llvm::sys::fs::remove(file);
+      llvm::sys::fs::remove(manifestPath(key));
+      return {};
+    }
+
+    // Not requiring a null terminator is what allows MemoryBuffer to mmap
+    // the file instead of copying it.
+#if LLVM_VERSION_MAJOR >= 13
+    auto buf = llvm::MemoryBuffer::getFile(file, false, false, false);
+#else
+    auto buf = llvm::MemoryBuffer::getFile(file, -1, false, false);
+#endif
+    if (!buf)
+      return {};
+
+    qDebug() << "JIT object cache hit:" << QString::fromStdString(file);
+    return std::move(*buf);
+  }
+
+  //! Called by the JIT after code generation of a module
+  void notifyObjectCompiled(
+      const llvm::Module* M,
+      llvm::MemoryBufferRef obj) override
+  {
+    store(M->getModuleIdentifier(), obj);
+  }
+
+  void store(const std::string& key, llvm::MemoryBufferRef obj)
+  {
+    if (!enabled() || key.empty())
+      return;
+
+    // Write to a temporary file and rename it so that concurrent
+    // instances never see a partially written object
+    int fd{};
+    llvm::SmallString<128> tmp;
+    if (llvm::sys::fs::createUniqueFile(path(key) + ".%%%%%%", fd, tmp))
+      return;
+
+    {
+      llvm::raw_fd_ostream os(fd, true);
+      os << obj.getBuffer();
+      if (os.has_error())
+      {
+        os.clear_error();
+        llvm::sys::fs::remove(tmp);
+        return;
+      }
+    }
+
+    if (llvm::sys::fs::rename(tmp, path(key)))
+      llvm::sys::fs::remove(tmp);
+  }
+
+  //! To be called before storing an object: objects without a manifest are
+  //! never loaded
+  void storeDependencies(
+      const std::string& key,
+      const std::vector<std::string>& files,
+      const std::vector<CompileRemark>& remarks = {})
+  {
+    if (!enabled() || key.empty())
+      return;
+    DependencyManifest::write(manifestPath(key), key, files, remarks);
+  }
+
+  std::vector<std::string> dependencies(const std::string& key) const
+  {
+    return DependencyManifest::files(manifestPath(key));
+  }
+
+  //! The remarks of the build of a cached object
+  std::vector<CompileRemark> remarks(const std::string& key) const
+  {
+    return DependencyManifest::remarks(manifestPath(key));
+  }
+
+  //! JitCompiler::compile looks the object up before building the IR ;
+  //! by the time the JIT asks, the module is always newer than the cache
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module*) override
+  {
+    return {};
+  }
+
+private:
+  std::string m_dir;
+};
+}
@@ -0,0 +1,167 @@
+#include <JitCpp/Compiler/RealtimeCheck.hpp>
+
+#include <llvm/ADT/StringSet.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Path.h>
+
+#include <deque>
+#include <set>
+#include <unordered_map>
+
+namespace Jit
+{
+const char* realtimeUnsafeReason(llvm::StringRef name) noexcept
+{
+  static const llvm::StringSet<> allocation{
+      "malloc", "calloc", "realloc", "free", "aligned_alloc",
+      "posix_memalign", "valloc", "strdup", "_aligned_malloc", "_aligned_free"};
+  static const llvm::StringSet<> locks{
+      "pthread_mutex_lock", "pthread_rwlock_rdlock", "pthread_rwlock_wrlock",
+      "pthread_cond_wait", "pthread_cond_timedwait", "pthread_join",
+      "sem_wait", "_Mtx_lock", "EnterCriticalSection",
+      "AcquireSRWLockExclusive", "AcquireSRWLockShared", "WaitForSingleObject"};
+  static const llvm::StringSet<> system{
+      "open", "close", "read", "write", "fopen", "fclose", "fread", "fwrite",
+      "fflush", "printf", "fprintf", "puts", "fputs", "putchar", "sleep",
+      "usleep", "nanosleep", "clock_nanosleep", "syscall", "mmap", "munmap",
+      "system", "Sleep"};
+  static const llvm::StringSet<> exceptions{
+      "__cxa_throw", "__cxa_allocate_exception", "__cxa_rethrow",
+      "_CxxThrowException"};
+
+  if (allocation.count(name) || name.startswith("_Znw")
+      || name.startswith("_Zna") || name.startswith("_Zdl")
+      || name.startswith("_Zda") || name.startswith("??2@")
+      || name.startswith("??_U@") || name.startswith("??3@")
+      || name.startswith("??_V@"))
+    return "allocates or frees memory";
+  if (locks.count(name) || name.contains("mutex4lock"))
+    return "may block on a lock";
+  if (system.count(name))
+    return "performs a system call";
+  if (name.contains("basic_ostream") || name.contains("basic_istream")
+      || name.startswith("_ZNSo") || name.startswith("_ZNSi"))
+    return "uses iostreams";
+  if (exceptions.count(name) || name.contains("__throw_"))
+    return "throws an exception";
+  return nullptr;
+}
+
+//! Entry points called by the execution thread
+static bool isAudioEntryPoint(const llvm::Function& f)
+{
+  const auto name = f.getName();
+  return name == "score_bytebeat" || name == "score_block_process"
+         || name == "score_block_fused" || name == "score_poly_process"
+         || name == "score_rgba"
+         // Overrides of graph_node::run(const token_request&, exec_state_facade)
+         || name.contains("3runERKN5ossia13token_request")
+         || (name.startswith("?run@") && name.contains("token_request"));
+}
+
+//! Line of the script a call comes from: inlined code points to the
+//! place it was inlined at
+static unsigned scriptLine(const llvm::Instruction& inst, llvm::StringRef file)
+{
+  auto loc = inst.getDebugLoc().get();
+  unsigned line = 0;
+  for (; loc; loc = loc->getInlinedAt())
+  {
+    if (llvm::sys::path::filename(loc->getFilename()) == file)
+      line = loc->getLine();
+  }
+  return line;
+}
+
+char RealtimeSafetyPass::ID = 0;
+
+RealtimeSafetyPass::RealtimeSafetyPass(std::vector<CompileRemark>& findings)
+    : llvm::ModulePass{ID}
+    , m_findings{findings}
+{
+}
+
+llvm::StringRef RealtimeSafetyPass::getPassName() const
+{
+  return "score real-time safety check";
+}
+
+void RealtimeSafetyPass::getAnalysisUsage(llvm::AnalysisUsage& usage) const
+{
+  usage.setPreservesAll();
+}
+
+bool RealtimeSafetyPass::runOnModule(llvm::Module& m)
+{
+  const auto file = llvm::sys::path::filename(m.getSourceFileName());
+
+  // For each reachable function, the line of the script it is called from
+  std::unordered_map<const llvm::Function*, unsigned> reached;
+  std::deque<const llvm::Function*> queue;
+  for (const auto& f : m)
+  {
+    if (!f.isDeclaration() && isAudioEntryPoint(f))
+    {
+      reached[&f] = 0;
+      queue.push_back(&f);
+    }
+  }
+
+  std::set<std::pair<unsigned, std::string>> reported;
+  while (!queue.empty())
+  {
+    auto f = queue.front();
+    queue.pop_front();
+    const unsigned callerLine = reached[f];
+
+    for (const auto& inst : llvm::instructions(*f))
+    {
+      auto call = llvm::dyn_cast<llvm::CallBase>(&inst);
+      if (!call)
+        continue;
+
+      // Indirect calls cannot be followed
+      auto callee = call->getCalledFunction();
+      if (!callee || callee->isIntrinsic())
+        continue;
+
+      unsigned line = scriptLine(inst, file);
+      if (line == 0)
+        line = callerLine;
+
+      if (!callee->isDeclaration())
+      {
+        if (reached.emplace(callee, line).second)
+          queue.push_back(callee);
+        continue;
+      }
+
+      if (auto reason = realtimeUnsafeReason(callee->getName()))
+      {
+        const auto name = callee->getName().str();
+        if (reported.emplace(line, name).second)
+          m_findings.push_back(
+              {int(line), "realtime", name + " " + reason});
+      }
+    }
+  }
+  return false;
+}
+
+std::vector<CompileRemark> checkRealtimeSafety(llvm::Module& m)
+{
+  std::vector<CompileRemark> findings;
+  llvm::legacy::PassManager pm;
+  pm.add(new RealtimeSafetyPass{findings});
+  pm.run(m);
+
+  std::sort(findings.begin(), findings.end(), [](const auto& a, const auto& b) {
+    return a.line < b.line;
+  });
+  return findings;
+}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <JitCpp/JitUtils.hpp>
+
+#include <llvm/Pass.h>
+
+#include <vector>
+
+namespace Jit
+{
+/**
+ * @brief Flags the calls which are not real-time safe in the audio code of
+ * a script.
+ *
+ * Walks the call graph from the entry points run on the execution thread:
+ * the run() overrides of the nodes, score_bytebeat, score_block_process,
+ * score_block_fused, score_poly_process and score_rgba. Calls to the allocator, to locks, to I/O and system calls, to
+ * the iostreams, and exception throws are reported as "realtime" remarks,
+ * at the line of the script the call comes from.
+ *
+ * The module is the optimized one: what was inlined or removed is not
+ * reported. Line numbers need the location tracking enabled by
+ * CompilerOptions::OptimizationRemarks.
+ */
+class RealtimeSafetyPass final : public llvm::ModulePass
+{
+public:
+  static char ID;
+
+  explicit RealtimeSafetyPass(std::vector<CompileRemark>& findings);
+
+  bool runOnModule(llvm::Module& m) override;
+  llvm::StringRef getPassName() const override;
+  void getAnalysisUsage(llvm::AnalysisUsage& usage) const override;
+
+private:
+  std::vector<CompileRemark>& m_findings;
+};
+
+//! Runs RealtimeSafetyPass on a module
+std::vector<CompileRemark> checkRealtimeSafety(llvm::Module& m);
+
+//! Why a function must not be called on the audio thread, or nullptr
+const char* realtimeUnsafeReason(llvm::StringRef name) noexcept;
+}
@@ -0,0 +1,65 @@
+#include <JitCpp/ExecutionContext.hpp>
+#include <JitCpp/ClangDriver.hpp>
+
+#include <Audio/Settings/Model.hpp>
+
+#include <score/application/ApplicationContext.hpp>
+
+#include <QDir>
+#include <QFile>
+
+namespace Jit
+{
+static const char prelude[] = R"_(#pragma once
+namespace score::jit
+{
+inline constexpr int buffer_size = SCORE_JIT_BUFFER_SIZE;
+inline constexpr double sample_rate = SCORE_JIT_SAMPLE_RATE;
+}
+)_";
+
+//! Written once per run ; its content never changes so that it does not
+//! invalidate the object cache
+static std::string preludePath()
+{
+  static const std::string path = [] {
+    QString dir = QDir::tempPath();
+    if (auto db = ClangCC1Driver::bitcodeDatabase(); db && db->mkpath("include"))
+      dir = db->absolutePath() + "/include";
+
+    const auto file = dir + "/score_jit_context.hpp";
+    QFile f{file};
+    if (!f.open(QIODevice::ReadOnly) || f.readAll() != prelude)
+    {
+      f.close();
+      if (f.open(QIODevice::WriteOnly))
+        f.write(prelude);
+    }
+    return file.toStdString();
+  }();
+  return path;
+}
+
+ExecutionContext ExecutionContext::current()
+{
+  auto& settings = score::AppContext().settings<Audio::Settings::Model>();
+  return {settings.getBufferSize(), settings.getRate()};
+}
+
+std::vector<std::string> ExecutionContext::flags() const
+{
+  return {
+      "-DSCORE_JIT_BUFFER_SIZE=" + std::to_string(bufferSize),
+      "-DSCORE_JIT_SAMPLE_RATE=" + std::to_string(sampleRate) + ".",
+      "-include",
+      preludePath()};
+}
+
+void ExecutionContext::onChanged(QObject* context, std::function<void()> f)
+{
+  auto& settings = score::AppContext().settings<Audio::Settings::Model>();
+  QObject::connect(
+      &settings, &Audio::Settings::Model::BufferSizeChanged, context, f);
+  QObject::connect(&settings, &Audio::Settings::Model::RateChanged, context, f);
+}
+}
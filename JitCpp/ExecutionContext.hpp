@@ -0,0 +1,41 @@
+#pragma once
+#include <QObject>
+
+#include <score_addon_jit_export.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Jit
+{
+/**
+ * @brief Audio settings the scripts are specialized for.
+ *
+ * Scripts are compiled with SCORE_JIT_BUFFER_SIZE and SCORE_JIT_SAMPLE_RATE
+ * defined, and with a prelude giving them as constants:
+ *
+ * @code
+ * score::jit::buffer_size; // int
+ * score::jit::sample_rate; // double
+ * @endcode
+ *
+ * Loops over a whole buffer thus get a known trip count. The nodes may
+ * still be given other sizes, e.g. while the settings are being changed,
+ * so the code has to check the actual size before relying on it.
+ */
+struct SCORE_ADDON_JIT_EXPORT ExecutionContext
+{
+  int bufferSize{};
+  int sampleRate{};
+
+  //! From the audio settings ; to be called on the GUI thread
+  static ExecutionContext current();
+
+  //! Compile flags defining the constants and including the prelude
+  std::vector<std::string> flags() const;
+
+  //! Calls f when the audio settings change, as long as context exists
+  static void onChanged(QObject* context, std::function<void()> f);
+};
+}
@@ -0,0 +1,210 @@
+#include <JitCpp/FunctionTrace.hpp>
+#include <JitCpp/ClangDriver.hpp>
+#include <JitCpp/Profiler.hpp>
+
+#include <llvm/Object/SymbolSize.h>
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace Jit
+{
+FunctionTrace& FunctionTrace::instance()
+{
+  static FunctionTrace trace;
+  return trace;
+}
+
+static uint32_t traceThreadId() noexcept
+{
+  static std::atomic<uint32_t> next{};
+  thread_local const uint32_t id = next++;
+  return id;
+}
+
+void FunctionTrace::record(void* fn, bool exit) noexcept
+{
+  if (!m_recording.load(std::memory_order_relaxed))
+    return;
+
+  // Several threads may write: each event gets its own slot,
+  // the oldest ones are overwritten.
+  const auto i = m_head.fetch_add(1, std::memory_order_relaxed);
+  auto& slot = m_events[i % capacity];
+  slot.sequence.store(2 * i + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.cycles.store(cycleCount(), std::memory_order_relaxed);
+  slot.function.store(fn, std::memory_order_relaxed);
+  slot.thread.store(traceThreadId(), std::memory_order_relaxed);
+  slot.exit.store(exit, std::memory_order_relaxed);
+  slot.sequence.store(2 * (i + 1), std::memory_order_release);
+}
+
+QString FunctionTrace::dumpPath()
+{
+  QString dir = QDir::tempPath();
+  if (auto db = ClangCC1Driver::bitcodeDatabase(); db && db->mkpath("traces"))
+    dir = db->absolutePath() + "/traces";
+
+  return dir + "/trace-"
+         + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+}
+
+bool FunctionTrace::dump(const QString& path) const
+{
+  const auto head = m_head.load();
+  const auto count = std::min<uint64_t>(head, capacity);
+  if (count == 0)
+    return false;
+
+  // The recording goes on: events still being written, or already
+  // overwritten by newer ones, are left out
+  std::vector<Event> events;
+  events.reserve(count);
+  for (auto i = head - count; i < head; i++)
+  {
+    const auto& slot = m_events[i % capacity];
+    const auto seq = slot.sequence.load(std::memory_order_acquire);
+    if (seq != 2 * (i + 1))
+      continue;
+
+    Event e{
+        slot.cycles.load(std::memory_order_relaxed),
+        slot.function.load(std::memory_order_relaxed),
+        slot.thread.load(std::memory_order_relaxed),
+        slot.exit.load(std::memory_order_relaxed)};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != seq)
+      continue;
+    events.push_back(e);
+  }
+  if (events.empty())
+    return false;
+
+  // Chrome traces are in microseconds
+  const auto freq = Profiler::frequency();
+  const auto t0 = events.front().cycles;
+
+  QJsonArray trace;
+  for (const auto& e : events)
+  {
+    trace.push_back(QJsonObject{
+        {"name",
+         QString::fromStdString(symbolName(reinterpret_cast<uint64_t>(e.function)))},
+        {"ph", e.exit ? "E" : "B"},
+        {"ts", double(e.cycles - t0) * 1e6 / freq},
+        {"pid", 0},
+        {"tid", int(e.thread)}});
+  }
+
+  QSaveFile f{path};
+  if (!f.open(QIODevice::WriteOnly))
+    return false;
+  f.write(QJsonDocument{QJsonObject{{"traceEvents", trace}}}.toJson(
+      QJsonDocument::Compact));
+  return f.commit();
+}
+
+void FunctionTrace::addSymbols(
+    uint64_t object,
+    std::vector<std::pair<uint64_t, std::pair<uint64_t, std::string>>> syms)
+{
+  std::lock_guard lck{m_symbolsMutex};
+  auto& addrs = m_objectSymbols[object];
+  for (auto& [addr, sym] : syms)
+  {
+    addrs.push_back(addr);
+    m_symbols[addr] = std::move(sym);
+  }
+}
+
+void FunctionTrace::removeSymbols(uint64_t object)
+{
+  std::lock_guard lck{m_symbolsMutex};
+  auto it = m_objectSymbols.find(object);
+  if (it == m_objectSymbols.end())
+    return;
+  for (auto addr : it->second)
+    m_symbols.erase(addr);
+  m_objectSymbols.erase(it);
+}
+
+std::string FunctionTrace::symbolName(uint64_t address) const
+{
+  {
+    std::lock_guard lck{m_symbolsMutex};
+    auto it = m_symbols.upper_bound(address);
+    if (it != m_symbols.begin())
+    {
+      --it;
+      if (address < it->first + std::max<uint64_t>(it->second.first, 1))
+        return it->second.second;
+    }
+  }
+
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)address);
+  return buf;
+}
+
+void TraceSymbolListener::notifyObjectLoaded(
+    ObjectKey key,
+    const llvm::object::ObjectFile& obj,
+    const llvm::RuntimeDyld::LoadedObjectInfo& info)
+{
+  using namespace llvm::object;
+
+  // The debug object has the symbols at their final addresses
+  auto debugObj = info.getObjectForDebug(obj);
+  if (!debugObj.getBinary())
+    return;
+
+  std::vector<std::pair<uint64_t, std::pair<uint64_t, std::string>>> syms;
+  for (const auto& [sym, size] : computeSymbolSizes(*debugObj.getBinary()))
+  {
+    auto type = sym.getType();
+    if (!type)
+    {
+      llvm::consumeError(type.takeError());
+      continue;
+    }
+    if (*type != SymbolRef::ST_Function)
+      continue;
+
+    auto name = sym.getName();
+    auto addr = sym.getAddress();
+    if (!name || !addr)
+    {
+      llvm::consumeError(name.takeError());
+      llvm::consumeError(addr.takeError());
+      continue;
+    }
+    syms.push_back({*addr, {size, name->str()}});
+  }
+
+  FunctionTrace::instance().addSymbols(key, std::move(syms));
+}
+
+void TraceSymbolListener::notifyFreeingObject(ObjectKey key)
+{
+  FunctionTrace::instance().removeSymbols(key);
+}
+}
+
+extern "C" {
+void score_jit_trace_enter(void* fn, void*)
+{
+  Jit::FunctionTrace::instance().record(fn, false);
+}
+
+void score_jit_trace_exit(void* fn, void*)
+{
+  Jit::FunctionTrace::instance().record(fn, true);
+}
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+#include <QString>
+
+#include <score_addon_jit_export.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Jit
+{
+/**
+ * @brief Function entries and exits of the scripts built with
+ * CompilerOptions::TraceFunctions.
+ *
+ * Such scripts are compiled with -finstrument-functions-after-inlining :
+ * every function which was not inlined calls the __cyg_profile_func_enter /
+ * __cyg_profile_func_exit hooks, which the JIT resolves to this ring buffer.
+ * Scripts built without the option are not instrumented at all.
+ */
+class SCORE_ADDON_JIT_EXPORT FunctionTrace
+{
+public:
+  static FunctionTrace& instance();
+
+  void setRecording(bool b) noexcept { m_recording.store(b); }
+  bool recording() const noexcept { return m_recording.load(); }
+
+  void record(void* fn, bool exit) noexcept;
+
+  //! Writes the buffer in the Chrome trace event format, which can be
+  //! opened in chrome://tracing or Perfetto.
+  bool dump(const QString& path) const;
+
+  //! Default location of the dumps
+  static QString dumpPath();
+
+  // Names of the JIT-compiled functions
+  void addSymbols(
+      uint64_t object,
+      std::vector<std::pair<uint64_t, std::pair<uint64_t, std::string>>> syms);
+  void removeSymbols(uint64_t object);
+  std::string symbolName(uint64_t address) const;
+
+private:
+  FunctionTrace() = default;
+
+  struct Event
+  {
+    uint64_t cycles;
+    void* function;
+    uint32_t thread;
+    bool exit;
+  };
+
+  //! An event is written while dump() may read it: its sequence is odd
+  //! while it is being written, then 2 * (index + 1), so that torn or
+  //! overwritten events are skipped
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> cycles;
+    std::atomic<void*> function;
+    std::atomic<uint32_t> thread;
+    std::atomic_bool exit;
+  };
+
+  static constexpr std::size_t capacity = 1 << 16;
+  std::array<Slot, capacity> m_events{};
+  std::atomic<uint64_t> m_head{};
+  std::atomic_bool m_recording{true};
+
+  mutable std::mutex m_symbolsMutex;
+  //! Start address -> size, name
+  std::map<uint64_t, std::pair<uint64_t, std::string>> m_symbols;
+  std::unordered_map<uint64_t, std::vector<uint64_t>> m_objectSymbols;
+};
+
+//! Registers the names of the functions of every object the JIT loads
+class TraceSymbolListener final : public llvm::JITEventListener
+{
+public:
+  void notifyObjectLoaded(
+      ObjectKey key,
+      const llvm::object::ObjectFile& obj,
+      const llvm::RuntimeDyld::LoadedObjectInfo& info) override;
+  void notifyFreeingObject(ObjectKey key) override;
+};
+}
+
+extern "C" {
+void score_jit_trace_enter(void* fn, void* site);
+void score_jit_trace_exit(void* fn, void* site);
+}
@@ -0,0 +1,64 @@
+#include <JitCpp/IncludeHoisting.hpp>
+
+#include <QRegularExpression>
+
+namespace Jit
+{
+QString hoistIncludes(const QString& source, QStringList& includes)
+{
+  static const QRegularExpression directive_re{
+      R"_(^[ \t]*#[ \t]*([a-z]+)[ \t]*([A-Za-z_0-9]*))_"};
+  static const QRegularExpression include_re{
+      R"_(^[ \t]*#[ \t]*include[ \t]*[<"][^\n]*$)_"};
+
+  auto lines = source.split('\n');
+
+  // An include guard, i.e. a first directive #ifndef X followed by
+  // #define X, is not a condition: its #if does not count
+  int guard = -1;
+  {
+    QString first;
+    for (int i = 0; i < lines.size(); i++)
+    {
+      const auto m = directive_re.match(lines[i]);
+      if (!m.hasMatch())
+        continue;
+      if (first.isEmpty())
+      {
+        if (m.captured(1) != "ifndef" || m.captured(2).isEmpty())
+          break;
+        first = m.captured(2);
+        guard = i;
+      }
+      else
+      {
+        if (m.captured(1) != "define" || m.captured(2) != first)
+          guard = -1;
+        break;
+      }
+    }
+  }
+
+  // Its #endif is then the one found at depth 0
+  int depth = 0;
+  for (int i = 0; i < lines.size(); i++)
+  {
+    auto& line = lines[i];
+    const auto d = directive_re.match(line).captured(1);
+    if (i == guard)
+      continue;
+    else if (d.startsWith("if"))
+      depth++;
+    else if (d == "endif" && depth > 0)
+      depth--;
+    else if (depth == 0 && include_re.match(line).hasMatch())
+    {
+      auto inc = line.trimmed();
+      if (!includes.contains(inc))
+        includes.push_back(inc);
+      line.clear();
+    }
+  }
+  return lines.join('\n');
+}
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+
+namespace Jit
+{
+/**
+ * @brief Takes the #include directives out of a source which is about to
+ * be wrapped in a namespace, as headers cannot be included there.
+ *
+ * Each include not already in includes is appended to it. In the source,
+ * they are blanked rather than removed to keep the line numbers of the
+ * diagnostics. The ones depending on a condition of the source stay in
+ * place ; an include guard around the source is not such a condition.
+ */
+QString hoistIncludes(const QString& source, QStringList& includes);
+}
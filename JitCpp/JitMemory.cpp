@@ -0,0 +1,80 @@
+#include <JitCpp/JitMemory.hpp>
+
+#include <algorithm>
+
+namespace Jit
+{
+JitMemory& JitMemory::instance()
+{
+  static JitMemory mem;
+  return mem;
+}
+
+std::shared_ptr<JitMemoryUsage>
+JitMemory::create(QString name, const void* owner)
+{
+  auto usage = std::make_shared<JitMemoryUsage>(std::move(name), owner);
+
+  std::lock_guard lck{m_mutex};
+  m_usages.erase(
+      std::remove_if(
+          m_usages.begin(),
+          m_usages.end(),
+          [](const auto& u) { return u.expired(); }),
+      m_usages.end());
+  m_usages.push_back(usage);
+  return usage;
+}
+
+static void accumulate(JitMemorySnapshot& s, const JitMemoryUsage& u)
+{
+  s.instances++;
+  s.code += u.code.load();
+  s.data += u.data.load();
+  s.rssDelta += u.rssDelta.load();
+  s.arenaOverflows += u.arenaOverflows.load();
+}
+
+JitMemorySnapshot JitMemory::forOwner(const void* owner) const
+{
+  JitMemorySnapshot s;
+  std::lock_guard lck{m_mutex};
+  for (const auto& weak : m_usages)
+  {
+    if (auto u = weak.lock(); u && u->owner == owner)
+    {
+      s.name = u->name;
+      accumulate(s, *u);
+    }
+  }
+  return s;
+}
+
+std::vector<JitMemorySnapshot> JitMemory::snapshots() const
+{
+  std::vector<JitMemorySnapshot> res;
+  std::lock_guard lck{m_mutex};
+  for (const auto& weak : m_usages)
+  {
+    if (auto u = weak.lock())
+    {
+      JitMemorySnapshot s;
+      s.name = u->name;
+      accumulate(s, *u);
+      res.push_back(std::move(s));
+    }
+  }
+  return res;
+}
+
+JitMemorySnapshot JitMemory::total() const
+{
+  JitMemorySnapshot s;
+  s.name = QStringLiteral("Total");
+  std::lock_guard lck{m_mutex};
+  for (const auto& weak : m_usages)
+    if (auto u = weak.lock())
+      accumulate(s, *u);
+  return s;
+}
+}
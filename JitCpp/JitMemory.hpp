@@ -0,0 +1,149 @@
+#pragma once
+#include <JitCpp/WarmUp.hpp>
+
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+
+#include <QString>
+
+#include <score_addon_jit_export.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Jit
+{
+//! Memory of one JIT instance, i.e. one build of a script or addon
+struct JitMemoryUsage
+{
+  JitMemoryUsage(QString name, const void* owner)
+      : name{std::move(name)}
+      , owner{owner}
+  {
+  }
+
+  const QString name;
+  const void* const owner{};
+
+  //! Bytes of the sections of the loaded objects
+  std::atomic<int64_t> code{};
+  std::atomic<int64_t> data{};
+
+  //! Growth of the whole process during the builds, code generation
+  //! included: what the frontend and the LLVM context did not give back,
+  //! and what the builds running on other compile threads took meanwhile
+  std::atomic<int64_t> rssDelta{};
+  std::atomic<int64_t> builds{};
+
+  //! Allocations which did not fit in the RealtimeArena
+  std::atomic<int64_t> arenaOverflows{};
+};
+
+struct JitMemorySnapshot
+{
+  QString name;
+  int instances{};
+  int64_t code{};
+  int64_t data{};
+  int64_t rssDelta{};
+  int64_t arenaOverflows{};
+};
+
+/**
+ * @brief Registry of the live JIT instances and of their memory.
+ *
+ * Each process may keep several instances alive: the current one and
+ * the previous builds still referenced by the execution.
+ */
+class SCORE_ADDON_JIT_EXPORT JitMemory
+{
+public:
+  static JitMemory& instance();
+
+  std::shared_ptr<JitMemoryUsage> create(QString name, const void* owner);
+
+  //! Every instance built for this owner (e.g. a process) still alive
+  JitMemorySnapshot forOwner(const void* owner) const;
+
+  //! One entry per instance
+  std::vector<JitMemorySnapshot> snapshots() const;
+  JitMemorySnapshot total() const;
+
+private:
+  mutable std::mutex m_mutex;
+  std::vector<std::weak_ptr<JitMemoryUsage>> m_usages;
+};
+
+//! Counts the sections allocated for the objects loaded by the JIT,
+//! and faults them in once they are ready, see prefault
+class JitMemoryManager final : public llvm::SectionMemoryManager
+{
+public:
+  explicit JitMemoryManager(std::shared_ptr<JitMemoryUsage> usage)
+      : m_usage{std::move(usage)}
+  {
+  }
+
+  ~JitMemoryManager() override
+  {
+    m_usage->code -= m_code;
+    m_usage->data -= m_data;
+  }
+
+  uint8_t* allocateCodeSection(
+      uintptr_t size,
+      unsigned alignment,
+      unsigned id,
+      llvm::StringRef name) override
+  {
+    m_code += size;
+    m_usage->code += size;
+    auto ptr
+        = SectionMemoryManager::allocateCodeSection(size, alignment, id, name);
+    m_sections.push_back({ptr, size, false, true});
+    return ptr;
+  }
+
+  uint8_t* allocateDataSection(
+      uintptr_t size,
+      unsigned alignment,
+      unsigned id,
+      llvm::StringRef name,
+      bool readOnly) override
+  {
+    m_data += size;
+    m_usage->data += size;
+    auto ptr = SectionMemoryManager::allocateDataSection(
+        size, alignment, id, name, readOnly);
+    m_sections.push_back({ptr, size, !readOnly, false});
+    return ptr;
+  }
+
+  bool finalizeMemory(std::string* err) override
+  {
+    if (SectionMemoryManager::finalizeMemory(err))
+      return true;
+
+    for (const auto& s : m_sections)
+      prefault(s.ptr, s.size, s.writable, s.code);
+    m_sections.clear();
+    return false;
+  }
+
+private:
+  struct section
+  {
+    uint8_t* ptr{};
+    uintptr_t size{};
+    bool writable{};
+    bool code{};
+  };
+
+  std::shared_ptr<JitMemoryUsage> m_usage;
+  std::vector<section> m_sections;
+  int64_t m_code{};
+  int64_t m_data{};
+};
+}
@@ -3,11 +3,14 @@
 #include <QDialog>
 #include <QDialogButtonBox>
 #include <QPlainTextEdit>
+#include <QPointer>
 #include <QPushButton>
 #include <QVBoxLayout>
 
 #include <JitCpp/Compiler/Driver.hpp>
 #include <JitCpp/EditScript.hpp>
+#include <JitCpp/ExecutionContext.hpp>
+#include <JitCpp/Profiler.hpp>
 //#include <JitCpp/Commands/EditJitEffect.hpp>
 
 #include <Process/Dataflow/PortFactory.hpp>
@@ -25,7 +28,6 @@ W_OBJECT_IMPL(Jit::JitEffectModel)
 
 namespace Jit
 {
-
 JitEffectModel::JitEffectModel(
     TimeVal t,
     const QString& jitProgram,
@@ -81,12 +83,17 @@ void JitEffectModel::setScript(const QString& txt)
   if(m_text != txt)
   {
     m_text = txt;
-    reload();
+    reloadAsync(CompilePriority::Editor);
     scriptChanged(txt);
   }
 }
 
-void JitEffectModel::init() {}
+void JitEffectModel::init()
+{
+  // Recompile for the new buffer size and sample rate
+  ExecutionContext::onChanged(
+      this, [this] { reloadAsync(CompilePriority::Playing); });
+}
 
 QString JitEffectModel::prettyName() const noexcept
 {
@@ -149,45 +156,135 @@ struct outlet_vis
   Process::Outlet* operator()() const noexcept { return nullptr; }
 };
 
-void JitEffectModel::reload()
+//! Whether an existing inlet stands for a port of a new node
+struct same_inlet_vis
 {
-  // FIXME dispos of them once unused at execution
-  static std::list<std::shared_ptr<NodeCompiler>> old_compilers;
-  if (m_compiler)
+  Process::Inlet& port;
+  bool operator()(const ossia::audio_port& p) const noexcept
   {
-    old_compilers.push_front(std::move(m_compiler));
-    if (old_compilers.size() > 5)
-      old_compilers.pop_back();
+    return dynamic_cast<Process::AudioInlet*>(&port);
   }
 
-  qDebug( "== reload() == ");
-  m_compiler = std::make_unique<NodeCompiler>("score_graph_node_factory");
-
-  qDebug( "     std::make_unique<NodeCompiler> == ");
-  auto fx_text = m_text.toLocal8Bit();
-  if (fx_text.isEmpty())
-    return;
+  bool operator()(const ossia::midi_port& p) const noexcept
+  {
+    return dynamic_cast<Process::MidiInlet*>(&port);
+  }
 
-  NodeFactory jit_factory;
-  try
+  bool operator()(const ossia::value_port& p) const noexcept
   {
-    jit_factory = (*m_compiler)(fx_text.toStdString(), {}, CompilerOptions{false});
+    if (dynamic_cast<Process::ControlInlet*>(&port))
+      return p.is_event;
+    return !p.is_event && dynamic_cast<Process::ValueInlet*>(&port);
+  }
+  bool operator()() const noexcept { return false; }
+};
 
-    qDebug( "     jit_factory == ");
-    if (!jit_factory)
-      return;
+struct same_outlet_vis
+{
+  Process::Outlet& port;
+  bool operator()(const ossia::audio_port& p) const noexcept
+  {
+    return dynamic_cast<Process::AudioOutlet*>(&port);
   }
-  catch (const std::exception& e)
+
+  bool operator()(const ossia::midi_port& p) const noexcept
   {
-    qDebug() << e.what();
-    errorMessage(0, e.what());
-    return;
+    return dynamic_cast<Process::MidiOutlet*>(&port);
   }
-  catch (...)
+
+  bool operator()(const ossia::value_port& p) const noexcept
   {
-    errorMessage(0, "JIT error");
-    return;
+    return dynamic_cast<Process::ValueOutlet*>(&port);
   }
+  bool operator()() const noexcept { return false; }
+};
+
+//! Same number, kind and order of ports: the model can keep its own
+static bool samePorts(
+    const Process::Inlets& inlets,
+    const Process::Outlets& outlets,
+    ossia::graph_node& node)
+{
+  const auto& ins = node.root_inputs();
+  const auto& outs = node.root_outputs();
+  if (ins.size() != inlets.size() || outs.size() != outlets.size())
+    return false;
+
+  for (std::size_t i = 0; i < ins.size(); i++)
+    if (!ins[i]->visit(same_inlet_vis{*inlets[i]}))
+      return false;
+  for (std::size_t i = 0; i < outs.size(); i++)
+    if (!outs[i]->visit(same_outlet_vis{*outlets[i]}))
+      return false;
+  return true;
+}
+
+void JitEffectModel::reload()
+{
+  m_builds.run(compileJob());
+}
+
+void JitEffectModel::reloadAsync(CompilePriority prio)
+{
+  m_builds.submit(prio, compileJob());
+}
+
+CompileScheduler::Work JitEffectModel::compileJob()
+{
+  auto fx_text = m_text.toLocal8Bit().toStdString();
+  QPointer<JitEffectModel> self = this;
+  const void* owner = this;
+  auto name = metadata().getName();
+  auto flags = ExecutionContext::current().flags();
+  return [self, owner, name, fx_text, flags](
+             const CancellationToken& cancelled)
+             -> CompileScheduler::Completion {
+    if (fx_text.empty())
+      return {};
+
+    qDebug( "== reload() == ");
+    auto compiler = makeDriver<NodeCompiler>("score_graph_node_factory", name, owner);
+
+    NodeFactory jit_factory;
+    CompilerOptions opts{false};
+    opts.OptimizationRemarks = true;
+
+    try
+    {
+      jit_factory = (*compiler)(fx_text, flags, opts, cancelled);
+
+      qDebug( "     jit_factory == ");
+      if (!jit_factory)
+        return {};
+    }
+    catch (const std::exception& e)
+    {
+      qDebug() << e.what();
+      return reportError(self, QString{e.what()});
+    }
+    catch (...)
+    {
+      return reportError(self, "JIT error");
+    }
+
+    auto remarks = remarksMessage(compiler->remarks());
+    return [self, compiler, jit_factory, remarks] {
+      if (self)
+      {
+        self->setFactory(compiler, jit_factory);
+        if (!remarks.second.empty())
+          self->errorMessage(
+              remarks.first, QString::fromStdString(remarks.second));
+      }
+    };
+  };
+}
+
+void JitEffectModel::setFactory(
+    std::shared_ptr<NodeCompiler> compiler,
+    NodeFactory jit_factory)
+{
+  m_builds.setCurrent(std::move(compiler));
 
   std::unique_ptr<ossia::graph_node> jit_object{jit_factory()};
   qDebug( "     jit_object == ");
@@ -199,6 +296,21 @@ void JitEffectModel::reload()
   // creating a new dsp
 
   factory = std::move(jit_factory);
+
+  // A new buffer size or sample rate, or code which only changes the
+  // processing: the cables and the control values are kept
+  if (samePorts(m_inlets, m_outlets, *jit_object))
+  {
+    const auto& ins = jit_object->root_inputs();
+    for (std::size_t i = 0; i < ins.size(); i++)
+    {
+      if (auto ctl = dynamic_cast<Process::ControlInlet*>(m_inlets[i]))
+        ctl->setDomain(State::Domain{ins[i]->target<ossia::value_port>()->domain});
+    }
+    changed();
+    return;
+  }
+
   qDeleteAll(m_inlets);
   qDeleteAll(m_outlets);
   m_inlets.clear();
@@ -292,7 +404,6 @@ EffectProcessFactory_T<Jit::JitEffectModel>::customConstructionData() const
 #include <ossia/dataflow/port.hpp>
 #include <ossia/network/value/value_conversion.hpp>
 
-#include <iostream>
 #include <vector>
 
 struct example : ossia::nonowning_graph_node {
@@ -333,43 +444,57 @@ EffectProcessFactory_T<Jit::JitEffectModel>::descriptor(QString d) const
 }
 namespace Execution
 {
+namespace
+{
+//! Forwards to the node built by the JIT and measures its run() ;
+//! the ports are the ones of the wrapped node.
+class profiled_node final : public ossia::nonowning_graph_node
+{
+public:
+  profiled_node(
+      std::shared_ptr<ossia::graph_node> node,
+      std::shared_ptr<Jit::NodeProfile> profile)
+      : m_node{std::move(node)}
+      , m_profile{std::move(profile)}
+  {
+    m_inlets = m_node->root_inputs();
+    m_outlets = m_node->root_outputs();
+  }
+
+  void run(const ossia::token_request& t, ossia::exec_state_facade e) noexcept
+      override
+  {
+    Jit::ScopedProfile p{m_profile.get(), e.bufferSize(), e.sampleRate()};
+    m_node->run(t, e);
+  }
+
+private:
+  std::shared_ptr<ossia::graph_node> m_node;
+  std::shared_ptr<Jit::NodeProfile> m_profile;
+};
+}
 
 Execution::JitEffectComponent::JitEffectComponent(
     Jit::JitEffectModel& proc,
     const Execution::Context& ctx,
     const Id<score::Component>& id,
     QObject* parent)
-    : ProcessComponent_T{proc, ctx, id, "JitComponent", parent}
+    : ScriptExecutor{proc, ctx, id, "JitComponent", parent}
 {
-  auto reset = [this, &proc, &ctx] {
+  auto reset = [this, &proc] {
+    if (!proc.factory)
+      return;
 
-    if (proc.factory)
-    {
-      this->node.reset(proc.factory());
-      if (this->node)
-      {
-        m_ossia_process = std::make_shared<ossia::node_process>(node);
-
-        for (std::size_t i = 0; i < proc.inlets().size(); i++)
-        {
-          auto inlet = dynamic_cast<Process::ControlInlet*>(proc.inlets()[i]);
-          if(!inlet)
-            continue;
-
-          auto inl = node->root_inputs()[i];
-          inl->target<ossia::value_port>()->write_value(inlet->value(), {});
-          connect(inlet, &Process::ControlInlet::valueChanged,
-                  this, [this, inl] (const ossia::value& v) {
-
-            system().executionQueue.enqueue([inl, val = v]() mutable {
-              inl->target<ossia::value_port>()->write_value(
-                  std::move(val), 1);
-            });
-
-          });
-        }
-      }
-    }
+    std::shared_ptr<ossia::graph_node> jit_node{proc.factory()};
+    if (!jit_node)
+      return;
+
+    if (auto profile = Jit::Profiler::instance().create(
+            &proc, proc.metadata().getName()))
+      setNode(std::make_shared<profiled_node>(
+          std::move(jit_node), std::move(profile)));
+    else
+      setNode(std::move(jit_node));
   };
   reset();
   con(proc, &Jit::JitEffectModel::changed,
@@ -1,5 +1,8 @@
 #pragma once
 #include <JitCpp/EditScript.hpp>
+#include <JitCpp/CompileScheduler.hpp>
+#include <JitCpp/ScriptBuilds.hpp>
+#include <JitCpp/ScriptExecutor.hpp>
 
 #include <Process/Execution/ProcessComponent.hpp>
 #include <Process/GenericProcessFactory.hpp>
@@ -82,9 +85,17 @@ public:
   PROPERTY(QString, script READ script WRITE setScript NOTIFY scriptChanged)
   private:
   void init();
+
+  //! Compiles synchronously, used when loading
   void reload();
+
+  //! Compiles in the background, the result is applied once ready
+  void reloadAsync(CompilePriority prio);
+  CompileScheduler::Work compileJob();
+  void setFactory(std::shared_ptr<NodeCompiler> compiler, NodeFactory factory);
+
   QString m_text;
-  std::unique_ptr<NodeCompiler> m_compiler;
+  ScriptBuilds<NodeCompiler> m_builds{"jit", this};
 };
 
 struct LanguageSpec
@@ -114,8 +125,7 @@ EffectProcessFactory_T<Jit::JitEffectModel>::descriptor(QString d) const;
 namespace Execution
 {
 class JitEffectComponent final
-    : public Execution::
-          ProcessComponent_T<Jit::JitEffectModel, ossia::node_process>
+    : public Jit::ScriptExecutor<Jit::JitEffectModel>
 {
   COMPONENT_METADATA("122ceaeb-cbcc-4808-91f2-1929e3ca8292")
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <QtGlobal>
 
 namespace Jit
 {
@@ -6,6 +7,30 @@ namespace Jit
 struct CompilerOptions
 {
   bool NoExceptions{true};
+
+  //! Destroy the clang frontend after each compile instead of leaking it
+  //! with -disable-free, so that live-coding does not grow the process.
+  bool FreeCompilerMemory{true};
+
+  //! Record the entries and exits of the non-inlined functions,
+  //! see FunctionTrace. Enabled with SCORE_JIT_TRACE.
+  bool TraceFunctions{qEnvironmentVariableIsSet("SCORE_JIT_TRACE")};
+
+  //! Report what the vectorizers and the inliner did, see CompileRemark
+  bool OptimizationRemarks{false};
+
+  //! Report the calls which are not real-time safe in the audio code,
+  //! see RealtimeSafetyPass
+  bool RealtimeCheck{true};
+
+  //! Refuse such code instead of reporting it. Enabled with
+  //! SCORE_JIT_REALTIME_STRICT
+  bool RealtimeStrict{qEnvironmentVariableIsSet("SCORE_JIT_REALTIME_STRICT")};
+
+  //! Let the loop vectorizer call the vector math library of the system
+  //! for sin, exp, pow... see vectorMathLibrary. Disabled with
+  //! SCORE_JIT_NO_VECLIB
+  bool VectorMath{!qEnvironmentVariableIsSet("SCORE_JIT_NO_VECLIB")};
 };
 
 }
@@ -9,6 +9,7 @@
 #include <QDirIterator>
 #include <Library/LibrarySettings.hpp>
 
+#include <llvm/Support/DynamicLibrary.h>
 #include <llvm/Support/Host.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/StringMap.h>
@@ -85,6 +86,35 @@ static inline std::string locateSDK()
 #endif
 }
 
+/**
+ * @brief The -fveclib mapping usable in this process, nullptr if none.
+ *
+ * Vector variants of the libm functions are only known to the loop
+ * vectorizer through this mapping: glibc's libmvec on x86-64 Linux,
+ * Accelerate on macOS. The library is loaded in the process so that the
+ * JIT resolves the calls like any other host symbol ; each JitCompiler
+ * does so when created, as cached objects skip populateCompileOptions.
+ */
+static inline const char* vectorMathLibrary()
+{
+  static const char* const veclib = []() -> const char* {
+    std::string err;
+#if defined(__linux__) && defined(__x86_64__) && defined(__GLIBC__) \
+    && LLVM_VERSION_MAJOR >= 16
+    if (!llvm::sys::DynamicLibrary::LoadLibraryPermanently("libmvec.so.1", &err))
+      return "libmvec";
+#elif defined(__APPLE__)
+    if (!llvm::sys::DynamicLibrary::LoadLibraryPermanently(
+            "/System/Library/Frameworks/Accelerate.framework/Accelerate", &err))
+      return "Accelerate";
+#endif
+    if (!err.empty())
+      qDebug() << "No vector math library:" << err.c_str();
+    return nullptr;
+  }();
+  return veclib;
+}
+
 static inline void populateCompileOptions(std::vector<std::string>& args, CompilerOptions opts)
 {
   args.push_back("-triple");
@@ -106,9 +136,16 @@ static inline void populateCompileOptions(std::vector<std::string>& args, Compil
 
 
   args.push_back("-std=c++2a");
-  args.push_back("-disable-free");
+  if (!opts.FreeCompilerMemory)
+    args.push_back("-disable-free");
   args.push_back("-fdeprecated-macro");
-  args.push_back("-fmath-errno");
+  // The vector math functions do not set errno: with it, no call to libm
+  // can be vectorized
+  const char* veclib = opts.VectorMath ? vectorMathLibrary() : nullptr;
+  if (veclib)
+    args.push_back(std::string("-fveclib=") + veclib);
+  else
+    args.push_back("-fmath-errno");
   // disappeared in clang 11 args.push_back("-fuse-init-array");
 
   // args.push_back("-mrelocation-model");
@@ -201,6 +238,18 @@ static inline void populateCompileOptions(std::vector<std::string>& args, Compil
   }
   args.push_back("-faddrsig");
 
+  if (opts.TraceFunctions)
+    args.push_back("-finstrument-functions-after-inlining");
+
+  if (opts.OptimizationRemarks)
+  {
+    // clang enables the location tracking needed to map them to lines
+    const char* passes = "loop-vectorize|slp-vectorizer|inline";
+    args.push_back(std::string("-Rpass=") + passes);
+    args.push_back(std::string("-Rpass-missed=") + passes);
+    args.push_back(std::string("-Rpass-analysis=") + passes);
+  }
+
   // args.push_back("-momit-leaf-frame-pointer");
   args.push_back("-vectorize-loops");
   args.push_back("-vectorize-slp");
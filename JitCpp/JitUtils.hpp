@@ -6,15 +6,22 @@
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/FileSystem.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace Jit
 {
 struct Exception final : std::runtime_error
 {
-  using std::runtime_error::runtime_error;
+  explicit Exception(const std::string& err)
+      : std::runtime_error{err}
+      , m_err{err}
+  {
+  }
+
   Exception(llvm::Error E) : std::runtime_error{"JIT error"}
   {
     llvm::handleAllErrors(std::move(E), [&](const llvm::ErrorInfoBase& EI) {
@@ -28,19 +35,31 @@ private:
   std::string m_err;
 };
 
-struct Timer
+//! An optimization remark of the compiled file, e.g. a loop not vectorized
+struct CompileRemark
+{
+  int line{};
+  std::string kind; //!< pass, pass-missed or pass-analysis
+  std::string message;
+};
+
+//! Formats the remarks for the errorMessage(line, msg) signal of the script
+//! processes ; lineOffset is the number of lines added before the script.
+inline std::pair<int, std::string>
+remarksMessage(const std::vector<CompileRemark>& remarks, int lineOffset = 0)
 {
-  std::chrono::high_resolution_clock::time_point t0;
-  Timer() { t0 = decltype(t0)::clock::now(); }
-  ~Timer()
+  int first = 0;
+  std::string msg;
+  for (const auto& r : remarks)
   {
-    auto t1 = decltype(t0)::clock::now();
-    std::cerr << "Took time: "
-              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0)
-                     .count()
-              << "\n";
+    const int line = std::max(1, r.line - lineOffset);
+    if (first == 0)
+      first = line;
+    msg += "line " + std::to_string(line) + " [" + r.kind + "] " + r.message
+           + "\n";
   }
-};
+  return {first, msg};
+}
 
 inline llvm::Expected<std::unique_ptr<llvm::Module>>
 readModuleFromBitcodeFile(llvm::StringRef bc, llvm::LLVMContext& context)
@@ -0,0 +1,185 @@
+#include <JitCpp/LazyAddon.hpp>
+
+#include <score/application/ApplicationContext.hpp>
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QRegularExpression>
+
+namespace Jit
+{
+
+PlaceholderProcessFactory::PlaceholderProcessFactory(
+    std::string addon,
+    LazyProcessInfo info,
+    LazyInstantiator inst)
+    : m_addon{std::move(addon)}
+    , m_info{std::move(info)}
+    , m_key{score::uuids::string_generator::compute(m_info.uuid)}
+    , m_instantiate{std::move(inst)}
+{
+}
+
+PlaceholderProcessFactory::~PlaceholderProcessFactory() {}
+
+UuidKey<Process::ProcessModel>
+PlaceholderProcessFactory::concreteKey() const noexcept
+{
+  return m_key;
+}
+
+QString PlaceholderProcessFactory::prettyName() const
+{
+  return m_info.prettyName;
+}
+
+QString PlaceholderProcessFactory::category() const
+{
+  return m_info.category;
+}
+
+Process::Descriptor PlaceholderProcessFactory::descriptor(QString) const
+{
+  Process::Descriptor d;
+  d.prettyName = m_info.prettyName;
+  d.categoryText = m_info.category;
+  return d;
+}
+
+Process::ProcessFlags PlaceholderProcessFactory::flags() const
+{
+  return Process::ProcessFlags::SupportsAll;
+}
+
+Process::ProcessModelFactory* PlaceholderProcessFactory::realFactory()
+{
+  if (m_real.empty())
+  {
+    qDebug() << "Compiling JIT addon on first use:" << m_info.prettyName;
+    auto plug = m_instantiate(m_addon);
+    if (!plug)
+      return nullptr;
+
+    auto facts = dynamic_cast<score::FactoryInterface_QtInterface*>(plug);
+    if (!facts)
+      return nullptr;
+
+    m_real = facts->factories(
+        score::AppContext(),
+        Process::ProcessModelFactory::static_interfaceKey());
+  }
+
+  for (auto& f : m_real)
+  {
+    if (auto pf = dynamic_cast<Process::ProcessModelFactory*>(f.get()))
+      if (pf->concreteKey() == m_key)
+        return pf;
+  }
+  return nullptr;
+}
+
+Process::ProcessModel* PlaceholderProcessFactory::make(
+    const TimeVal& duration,
+    const QString& data,
+    const Id<Process::ProcessModel>& id,
+    QObject* parent)
+{
+  if (auto fact = realFactory())
+    return fact->make(duration, data, id, parent);
+  return nullptr;
+}
+
+Process::ProcessModel*
+PlaceholderProcessFactory::load(const VisitorVariant& vis, QObject* parent)
+{
+  if (auto fact = realFactory())
+    return fact->load(vis, parent);
+  return nullptr;
+}
+
+PlaceholderPlugin::PlaceholderPlugin(
+    const LazyAddon& addon,
+    LazyInstantiator inst)
+    : m_id{addon.id}
+    , m_processes{addon.processes}
+    , m_instantiate{std::move(inst)}
+{
+}
+
+PlaceholderPlugin::~PlaceholderPlugin() {}
+
+score::PluginKey PlaceholderPlugin::key() const
+{
+  return score::PluginKey{
+      score::uuids::string_generator::compute(QString::fromStdString(m_id))};
+}
+
+score::Version PlaceholderPlugin::version() const
+{
+  return score::Version{0};
+}
+
+std::vector<std::unique_ptr<score::InterfaceBase>> PlaceholderPlugin::factories(
+    const score::ApplicationContext& ctx,
+    const score::InterfaceKey& key) const
+{
+  std::vector<std::unique_ptr<score::InterfaceBase>> res;
+  if (key != Process::ProcessModelFactory::static_interfaceKey())
+    return res;
+
+  for (const auto& proc : m_processes)
+  {
+    res.push_back(
+        std::make_unique<PlaceholderProcessFactory>(m_id, proc, m_instantiate));
+  }
+  return res;
+}
+
+static QString readStringField(const QByteArray& node, const char* field)
+{
+  QRegularExpression re{
+      QStringLiteral("%1\\s*=\\s*\"([^\"]*)\"").arg(field)};
+  auto match = re.match(QString::fromUtf8(node));
+  if (match.hasMatch())
+    return match.captured(1);
+  return {};
+}
+
+std::optional<LazyProcessInfo> parseNodeMetadata(const QByteArray& node)
+{
+  constexpr auto make_uuid_s = "make_uuid";
+  auto make_uuid = node.indexOf(make_uuid_s);
+  if (make_uuid == -1)
+    return std::nullopt;
+  int umin = node.indexOf('"', make_uuid + 9);
+  if (umin == -1)
+    return std::nullopt;
+  int umax = node.indexOf('"', umin + 1);
+  if (umax == -1)
+    return std::nullopt;
+  if ((umax - umin) != 37)
+    return std::nullopt;
+
+  LazyProcessInfo info;
+  info.uuid = QString{node.mid(umin + 1, 36)};
+  info.prettyName = readStringField(node, "prettyName");
+  info.category = readStringField(node, "category");
+  return info;
+}
+
+std::vector<LazyProcessInfo> parseAddonProcesses(const QJsonObject& addon)
+{
+  std::vector<LazyProcessInfo> res;
+  for (const auto& v : addon["processes"].toArray())
+  {
+    const auto obj = v.toObject();
+    LazyProcessInfo info;
+    info.uuid = obj["uuid"].toString();
+    info.prettyName = obj["name"].toString();
+    info.category = obj["category"].toString();
+    if (info.uuid.size() == 36)
+      res.push_back(std::move(info));
+  }
+  return res;
+}
+}
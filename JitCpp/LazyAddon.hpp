@@ -0,0 +1,118 @@
+#pragma once
+#include <Process/ProcessFactory.hpp>
+
+#include <score/plugins/qt_interfaces/FactoryInterface_QtInterface.hpp>
+#include <score/plugins/qt_interfaces/PluginRequirements_QtInterface.hpp>
+
+#include <QJsonObject>
+#include <QString>
+
+#include <JitCpp/JitOptions.hpp>
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Jit
+{
+//! What is known about a process before its addon has been compiled
+struct LazyProcessInfo
+{
+  QString uuid;
+  QString prettyName;
+  QString category;
+};
+
+//! An addon or node which has been scanned but not compiled yet.
+struct LazyAddon
+{
+  QString path;
+
+  //! Plug-in key with dashes removed, used for SCORE_JIT_ID
+  std::string id;
+  std::string cpp;
+  std::vector<std::string> flags;
+  std::vector<LazyProcessInfo> processes;
+
+  //! A single file of Library/Nodes rather than an addon folder
+  bool node{};
+
+  score::Plugin_QtInterface* instance{};
+};
+
+//! Called when a placeholder needs the real plug-in
+using LazyInstantiator
+    = std::function<score::Plugin_QtInterface*(const std::string& id)>;
+
+/**
+ * @brief Stands in for a process of a not-yet-compiled addon.
+ *
+ * The first time the process is created or loaded from a document,
+ * the addon is compiled, and the call is forwarded to the matching
+ * factory of the compiled plug-in. The real plug-in is then registered,
+ * which replaces this placeholder in the process factory list.
+ */
+class PlaceholderProcessFactory final : public Process::ProcessModelFactory
+{
+public:
+  PlaceholderProcessFactory(
+      std::string addon,
+      LazyProcessInfo info,
+      LazyInstantiator inst);
+  ~PlaceholderProcessFactory() override;
+
+  UuidKey<Process::ProcessModel> concreteKey() const noexcept override;
+  QString prettyName() const override;
+  QString category() const override;
+  Process::Descriptor descriptor(QString) const override;
+  Process::ProcessFlags flags() const override;
+
+  Process::ProcessModel* make(
+      const TimeVal& duration,
+      const QString& data,
+      const Id<Process::ProcessModel>& id,
+      QObject* parent) override;
+
+  Process::ProcessModel*
+  load(const VisitorVariant& vis, QObject* parent) override;
+
+private:
+  Process::ProcessModelFactory* realFactory();
+
+  std::string m_addon;
+  LazyProcessInfo m_info;
+  UuidKey<Process::ProcessModel> m_key;
+  LazyInstantiator m_instantiate;
+
+  std::vector<std::unique_ptr<score::InterfaceBase>> m_real;
+};
+
+//! Registers the placeholder factories of a lazy addon
+class PlaceholderPlugin final
+    : public score::Plugin_QtInterface
+    , public score::FactoryInterface_QtInterface
+{
+public:
+  PlaceholderPlugin(const LazyAddon& addon, LazyInstantiator inst);
+  ~PlaceholderPlugin() override;
+
+  score::PluginKey key() const override;
+  score::Version version() const override;
+
+  std::vector<std::unique_ptr<score::InterfaceBase>> factories(
+      const score::ApplicationContext& ctx,
+      const score::InterfaceKey& key) const override;
+
+private:
+  std::string m_id;
+  std::vector<LazyProcessInfo> m_processes;
+  LazyInstantiator m_instantiate;
+};
+
+//! Reads the uuid, name and category of a node from its source
+std::optional<LazyProcessInfo> parseNodeMetadata(const QByteArray& node);
+
+//! Reads the "processes" array of an addon.json, if any
+std::vector<LazyProcessInfo> parseAddonProcesses(const QJsonObject& addon);
+}
@@ -0,0 +1,135 @@
+#include <JitCpp/LibraryIndex.hpp>
+#include <JitCpp/ClangDriver.hpp>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include <utility>
+
+namespace Jit
+{
+static constexpr int indexVersion = 1;
+
+LibraryIndex::LibraryIndex()
+{
+  if (auto db = ClangCC1Driver::bitcodeDatabase())
+    m_path = db->absolutePath() + "/library-index.json";
+}
+
+LibraryIndex::~LibraryIndex() {}
+
+const LibraryIndexEntry* LibraryIndex::find(const QFileInfo& file) const
+{
+  auto it = m_entries.find(file.absoluteFilePath());
+  if (it == m_entries.end())
+    return nullptr;
+
+  if (it->size != file.size()
+      || it->mtime != file.lastModified().toMSecsSinceEpoch())
+    return nullptr;
+
+  return &*it;
+}
+
+LibraryIndexEntry* LibraryIndex::find(const QFileInfo& file)
+{
+  return const_cast<LibraryIndexEntry*>(std::as_const(*this).find(file));
+}
+
+LibraryIndexEntry&
+LibraryIndex::update(const QFileInfo& file, const QByteArray& content)
+{
+  auto& e = m_entries[file.absoluteFilePath()];
+  const auto hash
+      = QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex();
+  if (e.hash != hash)
+  {
+    e.hash = hash;
+    e.uuid.clear();
+    e.metadata = {};
+  }
+
+  e.size = file.size();
+  e.mtime = file.lastModified().toMSecsSinceEpoch();
+  m_dirty = true;
+  return e;
+}
+
+void LibraryIndex::prune(const QString& root, const QSet<QString>& seen)
+{
+  for (auto it = m_entries.begin(); it != m_entries.end();)
+  {
+    if (it.key().startsWith(root) && !seen.contains(it.key()))
+    {
+      it = m_entries.erase(it);
+      m_dirty = true;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+void LibraryIndex::load()
+{
+  if (m_path.isEmpty())
+    return;
+
+  QFile f{m_path};
+  if (!f.open(QIODevice::ReadOnly))
+    return;
+
+  const auto doc = QJsonDocument::fromJson(f.readAll()).object();
+  if (doc["Version"].toInt() != indexVersion)
+    return;
+
+  const auto files = doc["Files"].toObject();
+  for (auto it = files.begin(); it != files.end(); ++it)
+  {
+    const auto obj = it.value().toObject();
+    LibraryIndexEntry e;
+    e.mtime = obj["MTime"].toVariant().toLongLong();
+    e.size = obj["Size"].toVariant().toLongLong();
+    e.hash = obj["Hash"].toString().toLatin1();
+    e.uuid = obj["Uuid"].toString();
+    e.metadata = obj["Metadata"].toObject();
+    m_entries.insert(it.key(), std::move(e));
+  }
+  m_dirty = false;
+}
+
+void LibraryIndex::save() const
+{
+  if (m_path.isEmpty() || !m_dirty)
+    return;
+
+  QJsonObject files;
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    QJsonObject obj;
+    obj["MTime"] = QString::number(it->mtime);
+    obj["Size"] = QString::number(it->size);
+    obj["Hash"] = QString::fromLatin1(it->hash);
+    obj["Uuid"] = it->uuid;
+    obj["Metadata"] = it->metadata;
+    files[it.key()] = obj;
+  }
+
+  QJsonObject doc;
+  doc["Version"] = indexVersion;
+  doc["Files"] = files;
+
+  QSaveFile f{m_path};
+  if (!f.open(QIODevice::WriteOnly))
+    return;
+  f.write(QJsonDocument{doc}.toJson(QJsonDocument::Compact));
+  if (f.commit())
+    m_dirty = false;
+}
+}
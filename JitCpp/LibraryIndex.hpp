@@ -0,0 +1,60 @@
+#pragma once
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonObject>
+#include <QSet>
+#include <QString>
+
+namespace Jit
+{
+//! What we remember about a file of the Addons / Nodes library
+struct LibraryIndexEntry
+{
+  qint64 mtime{};
+  qint64 size{};
+  QByteArray hash;
+
+  //! Process uuid for nodes, plug-in key for addon.json
+  QString uuid;
+
+  //! Kind-specific metadata: node name & category, addon.json processes...
+  QJsonObject metadata;
+};
+
+/**
+ * @brief Persistent index of the Addons / Nodes library.
+ *
+ * Stored in ClangCC1Driver::bitcodeDatabase()/library-index.json.
+ * A file is only read again when its size or modification time
+ * differ from the indexed ones ; this makes rescans of a large, mostly
+ * unchanged library a matter of a few stat calls.
+ */
+class LibraryIndex
+{
+public:
+  LibraryIndex();
+  ~LibraryIndex();
+
+  //! Returns nullptr if the file changed since it was last indexed
+  const LibraryIndexEntry* find(const QFileInfo& file) const;
+  LibraryIndexEntry* find(const QFileInfo& file);
+
+  //! Re-indexes a file whose content was just read
+  LibraryIndexEntry&
+  update(const QFileInfo& file, const QByteArray& content);
+
+  //! Forget about the files under root which were not seen in the last scan
+  void prune(const QString& root, const QSet<QString>& seen);
+
+  //! To be called after modifying an entry returned by find()
+  void markDirty() noexcept { m_dirty = true; }
+
+  void load();
+  void save() const;
+
+private:
+  QString m_path;
+  QHash<QString, LibraryIndexEntry> m_entries;
+  mutable bool m_dirty{};
+};
+}
@@ -6,29 +6,38 @@
 #include <QJsonObject>
 #include <QRegularExpression>
 #include <QStringBuilder>
+#include <QJsonArray>
+
+#include <JitCpp/LibraryIndex.hpp>
 
 #include <vector>
 
 namespace Jit
 {
 
+struct AddonFile
+{
+  QString path;
+
+  //! Only read when the file is not in the library index
+  QString content;
+};
+
 struct AddonData
 {
   QJsonObject addon_info;
   std::string unity_cpp;
-  std::vector<std::pair<QString, QString>> files;
+  std::vector<AddonFile> files;
 };
 
 //! Combines all the source files of an addon into a single unity file to make
 //! build faster
-static AddonData loadAddon(const QString& addon)
+static AddonData loadAddon(const QString& addon, LibraryIndex& index)
 {
   AddonData data;
   if (QFile f(addon + "/addon.json"); f.open(QIODevice::ReadOnly))
     data.addon_info = QJsonDocument::fromJson(f.readAll()).object();
 
-  std::string cpp_files;
-  std::vector<std::pair<QString, QString>> files;
   QDirIterator it{addon,
                   {"*.cpp", "*.hpp"},
                   QDir::Filter::Files | QDir::Filter::NoDotAndDotDot,
@@ -36,72 +45,114 @@ static AddonData loadAddon(const QString& addon)
 
   while (it.hasNext())
   {
-    if (QFile f(it.next()); f.open(QIODevice::ReadOnly))
+    it.next();
+    const auto& fi = it.fileInfo();
+    if (fi.suffix() == "cpp")
     {
-      QFileInfo fi{f};
-      if (fi.suffix() == "cpp")
+      data.unity_cpp.append(
+          "#include \"" + it.filePath().toStdString() + "\"\n");
+    }
+
+    AddonFile file{fi.filePath(), {}};
+    if (!index.find(fi))
+    {
+      if (QFile f(fi.filePath()); f.open(QIODevice::ReadOnly))
       {
-        data.unity_cpp.append(
-            "#include \"" + it.filePath().toStdString() + "\"\n");
+        const auto content = f.readAll();
+        index.update(fi, content);
+        file.content = QString::fromUtf8(content);
       }
-
-      data.files.push_back({fi.filePath(), f.readAll()});
     }
+    data.files.push_back(std::move(file));
   }
   return data;
 }
 
+//! Only touches the file if its content would change, to keep its mtime
+//! and thus not invalidate anything which depends on it
+static void writeIfChanged(const QString& path, const QByteArray& content)
+{
+  if (QFile f{path}; f.open(QIODevice::ReadOnly))
+  {
+    if (f.size() == content.size() && f.readAll() == content)
+      return;
+  }
+
+  QFile f{path};
+  f.open(QIODevice::WriteOnly);
+  f.write(content);
+  f.close();
+}
+
+//! The SCORE_COMMAND_DECL commands of a file, cached in the library index
+static QJsonArray fileCommands(const AddonFile& file, LibraryIndex& index)
+{
+  QFileInfo fi{file.path};
+  auto e = index.find(fi);
+  if (e && e->metadata.contains("Commands"))
+    return e->metadata["Commands"].toArray();
+
+  QString content = file.content;
+  if (!e || content.isEmpty())
+  {
+    if (QFile f(file.path); f.open(QIODevice::ReadOnly))
+    {
+      const auto data = f.readAll();
+      e = &index.update(fi, data);
+      content = QString::fromUtf8(data);
+    }
+  }
+
+  static const QRegularExpression decl(
+      "SCORE_COMMAND_DECL\\([A-Za-z_0-9,:<>\r\n\t "
+      "]*\\(\\)[A-Za-z_0-9,\"':<>\r\n\t ]*\\)");
+
+  QJsonArray commands;
+  auto res = decl.globalMatch(content);
+  while (res.hasNext())
+  {
+    auto match = res.next();
+    if (auto txt = match.capturedTexts(); !txt.empty())
+    {
+      if (auto split = txt[0].split(","); split.size() > 1)
+        commands.push_back(split[1]);
+    }
+  }
+
+  if (e)
+  {
+    e->metadata["Commands"] = commands;
+    index.markDirty();
+  }
+  return commands;
+}
+
 //! Generates the score_myaddon_commands.hpp and score_myaddon_command_list.hpp
 //! files
 static void generateCommandFiles(
     const QString& output,
     const QString& addon_path,
-    const std::vector<std::pair<QString, QString>>& files)
+    const std::vector<AddonFile>& files,
+    LibraryIndex& index)
 {
-  QRegularExpression decl(
-      "SCORE_COMMAND_DECL\\([A-Za-z_0-9,:<>\r\n\t "
-      "]*\\(\\)[A-Za-z_0-9,\"':<>\r\n\t ]*\\)");
-  QRegularExpression decl_t(
-      "SCORE_COMMAND_DECL_T\\([A-Za-z_0-9,:<>\r\n\t ]*\\)");
-
   QString includes;
   QString commands;
   for (const auto& f : files)
   {
+    for (const auto& cmd : fileCommands(f, index))
     {
-      auto res = decl.globalMatch(f.second);
-      while (res.hasNext())
-      {
-        auto match = res.next();
-        if (auto txt = match.capturedTexts(); !txt.empty())
-        {
-          if (auto split = txt[0].split(","); split.size() > 1)
-          {
-            auto filename = f.first;
-            filename.remove(addon_path + "/");
-            includes += "#include <" + filename + ">\n";
-            commands += split[1] + ",\n";
-          }
-        }
-      }
+      auto filename = f.path;
+      filename.remove(addon_path + "/");
+      includes += "#include <" + filename + ">\n";
+      commands += cmd.toString() + ",\n";
     }
   }
   commands.remove(commands.length() - 2, 2);
   commands.push_back("\n");
   QDir{}.mkpath(output);
   auto out_name = QFileInfo{addon_path}.fileName().replace("-", "_");
-  {
-    QFile cmd_f{output + "/" + out_name + "_commands_files.hpp"};
-    cmd_f.open(QIODevice::WriteOnly);
-    cmd_f.write(includes.toUtf8());
-    cmd_f.close();
-  }
-  {
-    QFile cmd_f{output + "/" + out_name + "_commands.hpp"};
-    cmd_f.open(QIODevice::WriteOnly);
-    cmd_f.write(commands.toUtf8());
-    cmd_f.close();
-  }
+  writeIfChanged(output + "/" + out_name + "_commands_files.hpp", includes.toUtf8());
+  writeIfChanged(output + "/" + out_name + "_commands.hpp", commands.toUtf8());
 }
 
 //! Generates a score_myaddon_export.h file suitable for a static build
@@ -110,8 +161,6 @@ static void generateExportFile(
     const QString& addon_name,
     const QByteArray& addon_export)
 {
-  QFile export_file = QString{addon_files_path + "/" + addon_name + "_export.h"};
-  export_file.open(QIODevice::WriteOnly);
   QByteArray export_data{
     "#ifndef " + addon_export + "_EXPORT_H\n"
     "#define " + addon_export + "_EXPORT_H\n"
@@ -119,8 +168,7 @@ static void generateExportFile(
         "#define " + addon_export + "_DEPRECATED [[deprecated]]\n"
     "#endif\n"
   };
-  export_file.write(export_data);
-  export_file.close();
+  writeIfChanged(addon_files_path + "/" + addon_name + "_export.h", export_data);
 }
 
 //! Given an addon, generates all the files needed for the build of this addon
@@ -128,7 +176,8 @@ static void generateExportFile(
 static QString generateAddonFiles(
     QString addon_name,
     const QString& addon,
-    const std::vector<std::pair<QString, QString>>& files)
+    const std::vector<AddonFile>& files,
+    LibraryIndex& index)
 {
   addon_name.replace("-", "_");
   QByteArray addon_export = addon_name.toUpper().toUtf8();
@@ -137,7 +186,7 @@ static QString generateAddonFiles(
       = QDir::tempPath() + "/score-tmp-build/" + addon_name;
   QDir{}.mkpath(addon_files_path);
   generateExportFile(addon_files_path, addon_name, addon_export);
-  generateCommandFiles(addon_files_path, addon, files);
+  generateCommandFiles(addon_files_path, addon, files, index);
   return addon_files_path;
 }
 
@@ -0,0 +1,113 @@
+#include <JitCpp/IncludeHoisting.hpp>
+#include <JitCpp/NodeBuildGraph.hpp>
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+
+namespace Jit
+{
+
+bool NodeBuildGraph::add(const std::string& id, const QString& path)
+{
+  auto it = m_nodes.find(id);
+  if (it != m_nodes.end())
+  {
+    if (it->second.path != path)
+    {
+      qDebug() << "JIT node" << path << "has the same uuid as"
+               << it->second.path << ": ignored";
+      return false;
+    }
+    return true;
+  }
+
+  m_nodes.emplace(id, Node{path});
+  return true;
+}
+
+void NodeBuildGraph::remove(const std::string& id)
+{
+  m_nodes.erase(id);
+}
+
+void NodeBuildGraph::setBuilt(const std::string& id)
+{
+  if (auto it = m_nodes.find(id); it != m_nodes.end())
+    it->second.built = true;
+}
+
+void NodeBuildGraph::setUnbatched(const std::string& id)
+{
+  if (auto it = m_nodes.find(id); it != m_nodes.end())
+    it->second.unbatched = true;
+}
+
+NodeBuildGraph::Batch NodeBuildGraph::batchFor(const std::string& id) const
+{
+  std::vector<std::string> ids;
+  if (auto it = m_nodes.find(id); it != m_nodes.end())
+  {
+    if (it->second.unbatched)
+      return {};
+    ids.push_back(id);
+  }
+
+  for (const auto& [other, node] : m_nodes)
+  {
+    if (ids.size() >= maxBatchSize)
+      break;
+    if (other != id && !node.built && !node.unbatched)
+      ids.push_back(other);
+  }
+
+  return batch(ids);
+}
+
+NodeBuildGraph::Batch
+NodeBuildGraph::batch(const std::vector<std::string>& ids) const
+{
+  Batch batch;
+  QStringList includes;
+  QSet<QString> include_dirs;
+  std::string bodies;
+
+  auto add_node = [&](const std::string& id, const Node& node) {
+    QFile f{node.path};
+    if (!f.open(QIODevice::ReadOnly))
+      return;
+
+    const auto content = hoistIncludes(QString::fromUtf8(f.readAll()), includes);
+    include_dirs.insert(QFileInfo{node.path}.absolutePath());
+
+    const std::string ns = "score_jit_node_" + id;
+    bodies += "namespace " + ns + " {\n";
+    bodies += "#line 1 \"" + node.path.toStdString() + "\"\n";
+    bodies += content.toStdString();
+    bodies += "\n}\n";
+    bodies += "extern \"C\" __attribute__((visibility(\"default\")))\n"
+              "score::Plugin_QtInterface* plugin_instance_" + id + "() {\n"
+              "  return new Control::score_generic_plugin<" + ns + "::Node>;\n"
+              "}\n";
+
+    batch.ids.push_back(id);
+  };
+
+  for (const auto& id : ids)
+  {
+    if (auto it = m_nodes.find(id); it != m_nodes.end())
+      add_node(id, it->second);
+  }
+
+  batch.cpp = "#include <score/plugins/PluginInstances.hpp>\n";
+  for (const auto& inc : includes)
+    batch.cpp += inc.toStdString() + "\n";
+  batch.cpp += bodies;
+
+  for (const auto& dir : include_dirs)
+    batch.flags.push_back("-I" + dir.toStdString());
+
+  return batch;
+}
+}
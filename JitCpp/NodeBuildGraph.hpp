@@ -0,0 +1,56 @@
+#pragma once
+#include <QString>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Jit
+{
+/**
+ * @brief Groups the nodes of the library into batched translation units.
+ *
+ * Every node is included in its own namespace of a single unity source,
+ * after the union of the nodes' #include directives : score headers are thus
+ * parsed once per batch instead of once per node, and a single module
+ * provides all the plugin_instance_<uuid> entry points.
+ */
+class NodeBuildGraph
+{
+public:
+  struct Batch
+  {
+    std::vector<std::string> ids;
+    std::string cpp;
+    std::vector<std::string> flags;
+  };
+
+  //! Returns false if another file already provides this node
+  bool add(const std::string& id, const QString& path);
+  void remove(const std::string& id);
+
+  //! Marks a node as built, it won't be part of further batches
+  void setBuilt(const std::string& id);
+
+  //! The node will only be built alone, e.g. as it broke its batch
+  void setUnbatched(const std::string& id);
+
+  //! Generates the batch of all the nodes not built yet, starting with id.
+  //! Batches are limited to maxBatchSize nodes ; empty if id is unbatched.
+  Batch batchFor(const std::string& id) const;
+
+  //! Generates the batch of these nodes, e.g. part of a batch which failed
+  Batch batch(const std::vector<std::string>& ids) const;
+
+  static constexpr std::size_t maxBatchSize = 64;
+
+private:
+  struct Node
+  {
+    QString path;
+    bool built{};
+    bool unbatched{};
+  };
+  std::map<std::string, Node> m_nodes;
+};
+}
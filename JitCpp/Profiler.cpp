@@ -0,0 +1,162 @@
+#include <JitCpp/Profiler.hpp>
+
+#include <algorithm>
+#include <thread>
+
+namespace Jit
+{
+static int log2Bucket(uint64_t cycles) noexcept
+{
+  int b = 0;
+  while (cycles >>= 1)
+    b++;
+  return b;
+}
+
+void NodeProfile::record(uint64_t cycles, uint64_t deadline) noexcept
+{
+  constexpr auto rel = std::memory_order_relaxed;
+
+  // Requested by reset(), applied here so that it never races with the
+  // updates below
+  if (m_resetRequested.load(rel)
+      && m_resetRequested.exchange(false, std::memory_order_acquire))
+    clear();
+
+  // Single writer: no read-modify-write needed
+  auto& bucket = m_buckets[std::min(log2Bucket(cycles), bucketCount - 1)];
+  bucket.store(bucket.load(rel) + 1, rel);
+  m_count.store(m_count.load(rel) + 1, rel);
+  m_sum.store(m_sum.load(rel) + cycles, rel);
+  m_deadlineSum.store(m_deadlineSum.load(rel) + deadline, rel);
+  if (cycles < m_min.load(rel))
+    m_min.store(cycles, rel);
+  if (cycles > m_max.load(rel))
+    m_max.store(cycles, rel);
+  if (deadline > 0 && cycles > deadline)
+    m_overruns.store(m_overruns.load(rel) + 1, rel);
+}
+
+ProfileSnapshot NodeProfile::snapshot() const noexcept
+{
+  constexpr auto rel = std::memory_order_relaxed;
+  const double us = 1e6 / Profiler::frequency();
+
+  ProfileSnapshot s;
+  s.name = m_name;
+  // Not applied yet: the counters are about to be cleared
+  if (m_resetRequested.load(rel))
+    return s;
+
+  s.buffers = m_count.load(rel);
+  s.overruns = m_overruns.load(rel);
+  if (s.buffers == 0)
+    return s;
+
+  const auto sum = m_sum.load(rel);
+  s.minUs = m_min.load(rel) * us;
+  s.maxUs = m_max.load(rel) * us;
+  s.avgUs = double(sum) / s.buffers * us;
+  if (auto deadlines = m_deadlineSum.load(rel))
+    s.load = double(sum) / deadlines;
+
+  // Upper bound of the bucket holding the 99th percentile
+  const uint64_t target = (s.buffers * 99 + 99) / 100;
+  uint64_t seen = 0;
+  for (int b = 0; b < bucketCount; b++)
+  {
+    seen += m_buckets[b].load(rel);
+    if (seen >= target)
+    {
+      s.p99Us = std::min(double(uint64_t(2) << b), double(m_max.load(rel))) * us;
+      break;
+    }
+  }
+  return s;
+}
+
+void NodeProfile::reset() noexcept
+{
+  m_resetRequested.store(true, std::memory_order_release);
+}
+
+void NodeProfile::clear() noexcept
+{
+  constexpr auto rel = std::memory_order_relaxed;
+  for (auto& b : m_buckets)
+    b.store(0, rel);
+  m_count.store(0, rel);
+  m_sum.store(0, rel);
+  m_deadlineSum.store(0, rel);
+  m_min.store(UINT64_MAX, rel);
+  m_max.store(0, rel);
+  m_overruns.store(0, rel);
+}
+
+Profiler& Profiler::instance()
+{
+  static Profiler p;
+  return p;
+}
+
+Profiler::Profiler()
+    : m_enabled{qEnvironmentVariableIsSet("SCORE_JIT_PROFILE")}
+{
+  if (m_enabled)
+    frequency();
+}
+
+double Profiler::frequency() noexcept
+{
+  static const double freq = [] {
+    // Calibrate the cycle counter against the steady clock
+    using clk = std::chrono::steady_clock;
+    const auto t0 = clk::now();
+    const auto c0 = cycleCount();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto c1 = cycleCount();
+    const auto t1 = clk::now();
+
+    const double secs = std::chrono::duration<double>(t1 - t0).count();
+    return (secs > 0 && c1 > c0) ? (c1 - c0) / secs : 1.;
+  }();
+  return freq;
+}
+
+std::shared_ptr<NodeProfile> Profiler::create(const void* process, QString name)
+{
+  if (!m_enabled)
+    return {};
+
+  auto p = std::make_shared<NodeProfile>(std::move(name));
+
+  std::lock_guard lck{m_mutex};
+  m_profiles.erase(
+      std::remove_if(
+          m_profiles.begin(),
+          m_profiles.end(),
+          [=](const auto& e) { return e.first == process || e.second.expired(); }),
+      m_profiles.end());
+  m_profiles.emplace_back(process, p);
+  return p;
+}
+
+std::shared_ptr<NodeProfile> Profiler::find(const void* process) const
+{
+  std::lock_guard lck{m_mutex};
+  for (const auto& [proc, profile] : m_profiles)
+    if (proc == process)
+      return profile.lock();
+  return {};
+}
+
+std::vector<ProfileSnapshot> Profiler::snapshots() const
+{
+  std::vector<ProfileSnapshot> res;
+  std::lock_guard lck{m_mutex};
+  for (const auto& [proc, profile] : m_profiles)
+    if (auto p = profile.lock())
+      res.push_back(p->snapshot());
+  return res;
+}
+}
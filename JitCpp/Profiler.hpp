@@ -0,0 +1,137 @@
+#pragma once
+#include <QString>
+
+#include <score_addon_jit_export.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Jit
+{
+//! Cheapest monotonic counter available, in cycles or ticks
+inline uint64_t cycleCount() noexcept
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t v;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct ProfileSnapshot
+{
+  QString name;
+  uint64_t buffers{};
+  uint64_t overruns{};
+  double minUs{}, avgUs{}, maxUs{}, p99Us{};
+
+  //! Average fraction of the buffer duration spent in the node
+  double load{};
+};
+
+/**
+ * @brief Execution time of a node, per buffer.
+ *
+ * Written by the audio thread only, read from any thread: everything is a
+ * relaxed atomic, there are no locks. Durations are kept in a histogram
+ * with a bucket per power of two of cycles.
+ */
+class SCORE_ADDON_JIT_EXPORT NodeProfile
+{
+public:
+  explicit NodeProfile(QString name)
+      : m_name{std::move(name)}
+  {
+  }
+
+  void record(uint64_t cycles, uint64_t deadline) noexcept;
+  ProfileSnapshot snapshot() const noexcept;
+
+  //! Any thread: the audio thread clears the counters in its next record()
+  void reset() noexcept;
+
+private:
+  void clear() noexcept;
+
+  static constexpr int bucketCount = 64;
+  std::array<std::atomic<uint64_t>, bucketCount> m_buckets{};
+  std::atomic<uint64_t> m_count{};
+  std::atomic<uint64_t> m_sum{};
+  std::atomic<uint64_t> m_min{UINT64_MAX};
+  std::atomic<uint64_t> m_max{};
+  std::atomic<uint64_t> m_overruns{};
+  std::atomic<uint64_t> m_deadlineSum{};
+  std::atomic_bool m_resetRequested{};
+  QString m_name;
+};
+
+/**
+ * @brief Registry of the profiles of the running JIT nodes.
+ *
+ * Profiling is enabled by setting SCORE_JIT_PROFILE ; otherwise no profile
+ * is created and the nodes run without instrumentation.
+ */
+class SCORE_ADDON_JIT_EXPORT Profiler
+{
+public:
+  static Profiler& instance();
+
+  bool enabled() const noexcept { return m_enabled; }
+
+  //! Cycles per second of cycleCount(), calibrated on first use
+  static double frequency() noexcept;
+
+  //! Called on the GUI thread when a node is created for a process ;
+  //! returns nullptr if profiling is disabled.
+  std::shared_ptr<NodeProfile> create(const void* process, QString name);
+
+  //! The profile of the current node of a process, if any
+  std::shared_ptr<NodeProfile> find(const void* process) const;
+
+  std::vector<ProfileSnapshot> snapshots() const;
+
+private:
+  Profiler();
+
+  mutable std::mutex m_mutex;
+  std::vector<std::pair<const void*, std::weak_ptr<NodeProfile>>> m_profiles;
+  bool m_enabled{};
+};
+
+//! Measures a scope of the audio thread
+struct ScopedProfile
+{
+  ScopedProfile(NodeProfile* p, int frames, double rate) noexcept
+      : profile{p}
+  {
+    if (profile)
+    {
+      deadline = uint64_t(frames / rate * Profiler::frequency());
+      t0 = cycleCount();
+    }
+  }
+
+  ~ScopedProfile()
+  {
+    if (profile)
+      profile->record(cycleCount() - t0, deadline);
+  }
+
+  NodeProfile* profile{};
+  uint64_t t0{};
+  uint64_t deadline{};
+};
+}
@@ -0,0 +1,96 @@
+#include <JitCpp/ProfilerInspector.hpp>
+#include <JitCpp/FunctionTrace.hpp>
+#include <JitCpp/JitMemory.hpp>
+#include <JitCpp/JitOptions.hpp>
+#include <JitCpp/Profiler.hpp>
+
+#include <QPushButton>
+#include <QVBoxLayout>
+
+namespace Jit
+{
+static QString memoryText(const void* proc)
+{
+  auto kb = [](int64_t bytes) { return QString::number(bytes / 1024); };
+  const auto mine = JitMemory::instance().forOwner(proc);
+  const auto all = JitMemory::instance().total();
+  return QObject::tr("JIT builds alive: %1\n"
+                     "Code: %2 kB, data: %3 kB\n"
+                     "Process growth while building: %4 kB\n"
+                     "Allocations outside of the arena: %8\n"
+                     "All JIT builds: %5, code %6 kB, data %7 kB")
+      .arg(mine.instances)
+      .arg(kb(mine.code))
+      .arg(kb(mine.data))
+      .arg(kb(mine.rssDelta))
+      .arg(all.instances)
+      .arg(kb(all.code))
+      .arg(kb(all.data))
+      .arg(mine.arenaOverflows);
+}
+
+void setupProfilerInspector(QWidget* widget, QLabel* label, const void* proc)
+{
+  auto lay = new QVBoxLayout{widget};
+  lay->addWidget(label);
+  label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+  auto memory = new QLabel{widget};
+  lay->addWidget(memory);
+  memory->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+  auto update = [label, memory, proc] {
+    memory->setText(memoryText(proc));
+
+    if (!Profiler::instance().enabled())
+    {
+      label->setText(QObject::tr("Set SCORE_JIT_PROFILE to profile JIT nodes"));
+      return;
+    }
+
+    auto profile = Profiler::instance().find(proc);
+    if (!profile)
+    {
+      label->setText(QObject::tr("Not running"));
+      return;
+    }
+
+    const auto s = profile->snapshot();
+    label->setText(
+        QObject::tr("Buffers: %1\n"
+                    "Min: %2 µs\n"
+                    "Avg: %3 µs\n"
+                    "Max: %4 µs\n"
+                    "p99: %5 µs\n"
+                    "Load: %6 %\n"
+                    "Overruns: %7")
+            .arg(s.buffers)
+            .arg(s.minUs, 0, 'f', 1)
+            .arg(s.avgUs, 0, 'f', 1)
+            .arg(s.maxUs, 0, 'f', 1)
+            .arg(s.p99Us, 0, 'f', 1)
+            .arg(100. * s.load, 0, 'f', 1)
+            .arg(s.overruns));
+  };
+
+  if (CompilerOptions{}.TraceFunctions)
+  {
+    auto dump = new QPushButton{QObject::tr("Dump function trace"), widget};
+    auto path = new QLabel{widget};
+    path->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    lay->addWidget(dump);
+    lay->addWidget(path);
+    QObject::connect(dump, &QPushButton::clicked, widget, [path] {
+      const auto file = FunctionTrace::dumpPath();
+      path->setText(
+          FunctionTrace::instance().dump(file) ? file
+                                               : QObject::tr("No trace recorded"));
+    });
+  }
+
+  auto timer = new QTimer{widget};
+  QObject::connect(timer, &QTimer::timeout, widget, update);
+  timer->start(250);
+  update();
+}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <Process/Inspector/ProcessInspectorWidgetDelegate.hpp>
+#include <Process/Inspector/ProcessInspectorWidgetDelegateFactory.hpp>
+
+#include <JitCpp/JitModel.hpp>
+#include <Block/Block.hpp>
+#include <Bytebeat/Bytebeat.hpp>
+#include <Poly/Poly.hpp>
+
+#include <QLabel>
+#include <QTimer>
+
+namespace Jit
+{
+//! Updates the label periodically while the widget exists
+void setupProfilerInspector(QWidget* widget, QLabel* label, const void* proc);
+
+//! Shows the runtime profile of the node of a JIT process
+template <typename Model_T>
+class ProfilerInspector final : public Process::InspectorWidgetDelegate_T<Model_T>
+{
+public:
+  ProfilerInspector(
+      const Model_T& proc,
+      const score::DocumentContext& ctx,
+      QWidget* parent)
+      : Process::InspectorWidgetDelegate_T<Model_T>{proc, parent}
+      , m_label{new QLabel{this}}
+  {
+    setupProfilerInspector(this, m_label, &proc);
+  }
+
+private:
+  QLabel* m_label{};
+};
+
+class JitProfilerInspectorFactory final
+    : public Process::InspectorWidgetDelegateFactory_T<
+          JitEffectModel,
+          ProfilerInspector<JitEffectModel>>
+{
+  SCORE_CONCRETE("4ba4d7fb-1e63-45bf-a18a-16f3d54c7393")
+};
+
+class BytebeatProfilerInspectorFactory final
+    : public Process::InspectorWidgetDelegateFactory_T<
+          BytebeatModel,
+          ProfilerInspector<BytebeatModel>>
+{
+  SCORE_CONCRETE("d1f6a0bd-8a3e-4d51-9d7e-25c6a37f3b4e")
+};
+
+class BlockProfilerInspectorFactory final
+    : public Process::InspectorWidgetDelegateFactory_T<
+          BlockModel,
+          ProfilerInspector<BlockModel>>
+{
+  SCORE_CONCRETE("9343cfc3-a418-4462-b4a4-055635caa235")
+};
+
+class PolyProfilerInspectorFactory final
+    : public Process::InspectorWidgetDelegateFactory_T<
+          PolyModel,
+          ProfilerInspector<PolyModel>>
+{
+  SCORE_CONCRETE("ed75b208-8b61-481d-b797-4b0f1468e547")
+};
+}
@@ -0,0 +1,303 @@
+#include <JitCpp/RealtimeArena.hpp>
+
+#include <QDebug>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+namespace Jit
+{
+namespace
+{
+// Each block is preceded by a header giving its size class ; 16 bytes
+// keep the blocks aligned like malloc's
+constexpr std::size_t headerSize = 16;
+constexpr std::size_t minBlockSize = 16;
+
+int sizeClass(std::size_t size) noexcept
+{
+  int c = 0;
+  for (std::size_t s = minBlockSize; s < size; s *= 2)
+    c++;
+  return c;
+}
+
+constexpr std::size_t classSize(int c) noexcept
+{
+  return minBlockSize << c;
+}
+
+thread_local RealtimeArena* g_current{};
+
+// Arenas alive ; read without locking by free() on the audio thread
+constexpr int maxArenas = 256;
+std::array<std::atomic<RealtimeArena*>, maxArenas> g_arenas{};
+
+// Threads which may be using an arena found in g_arenas: an arena is
+// destroyed on the compile thread, once no one can still be freeing into it
+std::atomic<int> g_finding{};
+
+struct finding_scope
+{
+  finding_scope() noexcept { g_finding.fetch_add(1, std::memory_order_seq_cst); }
+  ~finding_scope() { g_finding.fetch_sub(1, std::memory_order_release); }
+};
+}
+
+RealtimeArena::RealtimeArena(
+    std::size_t bytes,
+    std::shared_ptr<JitMemoryUsage> usage)
+    : m_usage{std::move(usage)}
+{
+  static_assert(classSize(8) == maxBlockSize);
+
+  bool registered = false;
+  for (auto& slot : g_arenas)
+  {
+    RealtimeArena* empty{};
+    if (slot.compare_exchange_strong(empty, this))
+    {
+      registered = true;
+      break;
+    }
+  }
+
+  // free() would not find its blocks and give them to the system allocator:
+  // the arena stays empty and every allocation overflows instead
+  if (!registered)
+  {
+    qDebug() << "Too many JIT arenas, using the system allocator";
+    m_usage->arenaOverflows.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  m_storage = std::make_unique<uint8_t[]>(bytes + headerSize);
+
+  // Align the blocks, which follow their header
+  auto base = reinterpret_cast<uintptr_t>(m_storage.get());
+  base = (base + headerSize - 1) / headerSize * headerSize;
+  m_begin = reinterpret_cast<uint8_t*>(base);
+  m_end = m_begin + bytes;
+  m_bump = m_begin;
+}
+
+RealtimeArena::~RealtimeArena()
+{
+  for (auto& slot : g_arenas)
+  {
+    RealtimeArena* self = this;
+    if (slot.compare_exchange_strong(self, nullptr))
+      break;
+  }
+
+  // A find() which started before the arena was unregistered may have
+  // returned it: wait until those calls are over. Later ones do not see it.
+  while (g_finding.load(std::memory_order_seq_cst) != 0)
+    std::this_thread::yield();
+}
+
+std::size_t RealtimeArena::defaultSize() noexcept
+{
+  static const std::size_t size = [] {
+    bool ok{};
+    const int kb = qEnvironmentVariableIntValue("SCORE_JIT_ARENA_KB", &ok);
+    return ok ? std::size_t(std::max(0, kb)) * 1024 : 256 * 1024;
+  }();
+  return size;
+}
+
+void* RealtimeArena::allocate(std::size_t size) noexcept
+{
+  if (size > maxBlockSize)
+  {
+    m_usage->arenaOverflows.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  const int c = sizeClass(std::max<std::size_t>(size, 1));
+
+  // Recycled block: only this thread pops
+  auto& list = m_free[c];
+  free_block* head = list.load(std::memory_order_acquire);
+  while (head
+         && !list.compare_exchange_weak(
+             head, head->next, std::memory_order_acquire))
+    ;
+  if (head)
+    return head;
+
+  // New block
+  const std::size_t total = headerSize + classSize(c);
+  uint8_t* cur = m_bump.load(std::memory_order_relaxed);
+  do
+  {
+    if (std::size_t(m_end - cur) < total)
+    {
+      m_usage->arenaOverflows.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+  } while (!m_bump.compare_exchange_weak(
+      cur, cur + total, std::memory_order_relaxed));
+
+  cur[0] = uint8_t(c);
+  return cur + headerSize;
+}
+
+void RealtimeArena::deallocate(void* ptr) noexcept
+{
+  auto block = static_cast<free_block*>(ptr);
+  auto& list = m_free[sizeClass(blockSize(ptr))];
+  block->next = list.load(std::memory_order_relaxed);
+  while (!list.compare_exchange_weak(
+      block->next, block, std::memory_order_release))
+    ;
+}
+
+std::size_t RealtimeArena::blockSize(const void* ptr) const noexcept
+{
+  return classSize(static_cast<const uint8_t*>(ptr)[-int(headerSize)]);
+}
+
+RealtimeArena* RealtimeArena::current() noexcept
+{
+  return g_current;
+}
+
+RealtimeArena* RealtimeArena::find(const void* ptr) noexcept
+{
+  if (auto cur = g_current; cur && cur->contains(ptr))
+    return cur;
+  for (auto& slot : g_arenas)
+  {
+    // Ordered with g_finding, see ~RealtimeArena
+    auto arena = slot.load(std::memory_order_seq_cst);
+    if (arena && arena->contains(ptr))
+      return arena;
+  }
+  return nullptr;
+}
+
+ScopedArena::ScopedArena(RealtimeArena* arena) noexcept
+    : previous{g_current}
+{
+  g_current = arena;
+}
+
+ScopedArena::~ScopedArena()
+{
+  g_current = previous;
+}
+
+namespace
+{
+void* arena_malloc(std::size_t size) noexcept
+{
+  if (auto arena = g_current)
+    if (auto p = arena->allocate(size))
+      return p;
+  return std::malloc(size);
+}
+
+void arena_free(void* ptr) noexcept
+{
+  if (!ptr)
+    return;
+  finding_scope scope;
+  if (auto arena = RealtimeArena::find(ptr))
+    arena->deallocate(ptr);
+  else
+    std::free(ptr);
+}
+
+void* arena_calloc(std::size_t count, std::size_t size) noexcept
+{
+  if (size != 0 && count > std::size_t(-1) / size)
+    return nullptr;
+  auto p = arena_malloc(count * size);
+  if (p)
+    std::memset(p, 0, count * size);
+  return p;
+}
+
+void* arena_realloc(void* ptr, std::size_t size) noexcept
+{
+  if (!ptr)
+    return arena_malloc(size);
+
+  finding_scope scope;
+  auto arena = RealtimeArena::find(ptr);
+  if (!arena)
+    return std::realloc(ptr, size);
+
+  const auto old = arena->blockSize(ptr);
+  if (size <= old)
+    return ptr;
+
+  auto p = arena_malloc(size);
+  if (p)
+  {
+    std::memcpy(p, ptr, old);
+    arena->deallocate(ptr);
+  }
+  return p;
+}
+
+void* arena_new(std::size_t size)
+{
+  if (auto p = arena_malloc(size))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void* arena_new_nothrow(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return arena_malloc(size);
+}
+
+void arena_delete(void* ptr) noexcept
+{
+  arena_free(ptr);
+}
+
+void arena_delete_sized(void* ptr, std::size_t) noexcept
+{
+  arena_free(ptr);
+}
+
+void arena_delete_nothrow(void* ptr, const std::nothrow_t&) noexcept
+{
+  arena_free(ptr);
+}
+
+template <typename F>
+void* address(F* f) noexcept
+{
+  return reinterpret_cast<void*>(f);
+}
+}
+
+std::vector<std::pair<std::string, void*>> arenaSymbols()
+{
+  // Itanium mangling of size_t
+  const std::string sz = sizeof(std::size_t) == 8 ? "m" : "j";
+  return {
+      {"malloc", address(arena_malloc)},
+      {"free", address(arena_free)},
+      {"calloc", address(arena_calloc)},
+      {"realloc", address(arena_realloc)},
+      {"_Znw" + sz, address(arena_new)},
+      {"_Zna" + sz, address(arena_new)},
+      {"_Znw" + sz + "RKSt9nothrow_t", address(arena_new_nothrow)},
+      {"_Zna" + sz + "RKSt9nothrow_t", address(arena_new_nothrow)},
+      {"_ZdlPv", address(arena_delete)},
+      {"_ZdaPv", address(arena_delete)},
+      {"_ZdlPv" + sz, address(arena_delete_sized)},
+      {"_ZdaPv" + sz, address(arena_delete_sized)},
+      {"_ZdlPvRKSt9nothrow_t", address(arena_delete_nothrow)},
+      {"_ZdaPvRKSt9nothrow_t", address(arena_delete_nothrow)}};
+}
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <JitCpp/JitMemory.hpp>
+
+#include <score_addon_jit_export.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Jit
+{
+/**
+ * @brief Lock-free pool for the allocations of the JIT'd audio code.
+ *
+ * malloc / free and operator new / delete are interposed in the JIT'd
+ * code (see arenaSymbols): while a ScopedArena is active on a thread, the
+ * allocations of up to maxBlockSize bytes come from the arena of the
+ * build. The arena is split in size classes: blocks are bump-allocated
+ * then recycled through one free list per class. Only the thread running
+ * the node allocates, while any thread may free, which keeps the free
+ * lists ABA-safe without locks.
+ *
+ * Bigger allocations, and the ones once the arena is full, fall back to
+ * the system allocator and are counted in JitMemoryUsage::arenaOverflows.
+ * So do all of them when the arena could not be registered for find(), as
+ * too many are alive.
+ *
+ * Only suited to code which does not share heap objects with the host,
+ * such as block, poly and bytebeat scripts: memory of the arena must not be
+ * freed by code outside of the JIT. This includes the standard library
+ * classes whose members are instantiated in the shared library, such as
+ * std::string or the streams: their inlined members allocate from the arena,
+ * while the ones which are not inlined free with the host's operator delete.
+ */
+class SCORE_ADDON_JIT_EXPORT RealtimeArena
+{
+public:
+  static constexpr std::size_t maxBlockSize = 4096;
+
+  RealtimeArena(std::size_t bytes, std::shared_ptr<JitMemoryUsage> usage);
+  ~RealtimeArena();
+  RealtimeArena(const RealtimeArena&) = delete;
+  RealtimeArena& operator=(const RealtimeArena&) = delete;
+
+  //! From SCORE_JIT_ARENA_KB (256 kB by default), 0 disables the arenas
+  static std::size_t defaultSize() noexcept;
+
+  //! nullptr when the block does not fit
+  void* allocate(std::size_t size) noexcept;
+  void deallocate(void* ptr) noexcept;
+
+  bool contains(const void* ptr) const noexcept
+  {
+    auto p = static_cast<const uint8_t*>(ptr);
+    return p >= m_begin && p < m_end;
+  }
+
+  //! Size of a block of the arena
+  std::size_t blockSize(const void* ptr) const noexcept;
+
+  //! Arena of the current thread, see ScopedArena
+  static RealtimeArena* current() noexcept;
+
+  //! Arena a block belongs to, nullptr for the system allocator's.
+  //! Only used by the interposed functions, which keep the arena from
+  //! being destroyed while they use it
+  static RealtimeArena* find(const void* ptr) noexcept;
+
+private:
+  friend struct ScopedArena;
+  struct free_block
+  {
+    free_block* next;
+  };
+
+  std::unique_ptr<uint8_t[]> m_storage;
+  uint8_t* m_begin{};
+  uint8_t* m_end{};
+  std::atomic<uint8_t*> m_bump{};
+  std::array<std::atomic<free_block*>, 9> m_free{};
+  std::shared_ptr<JitMemoryUsage> m_usage;
+};
+
+//! Makes the JIT'd code called in this scope allocate from an arena
+struct ScopedArena
+{
+  explicit ScopedArena(RealtimeArena* arena) noexcept;
+  ~ScopedArena();
+
+  RealtimeArena* previous{};
+};
+
+//! Mangled names and addresses of the allocation functions to interpose
+SCORE_ADDON_JIT_EXPORT
+std::vector<std::pair<std::string, void*>> arenaSymbols();
+}
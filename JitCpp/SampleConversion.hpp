@@ -0,0 +1,21 @@
+#pragma once
+
+namespace Jit
+{
+/**
+ * @brief Converts samples between the graph's double buffers and the
+ * float or double buffers of the scripts.
+ *
+ * A plain loop over non-aliasing pointers: the compiler turns it into
+ * packed conversions (cvtpd2ps & co.).
+ */
+template <typename In, typename Out>
+inline void convertSamples(
+    const In* __restrict in,
+    Out* __restrict out,
+    int frames) noexcept
+{
+  for (int i = 0; i < frames; i++)
+    out[i] = Out(in[i]);
+}
+}
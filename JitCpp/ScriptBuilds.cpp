@@ -0,0 +1,20 @@
+#include <JitCpp/ScriptBuilds.hpp>
+
+#include <QCoreApplication>
+#include <QTimer>
+
+namespace Jit
+{
+//! Far more than the execution takes to run the queue which switches the
+//! nodes to the new build
+static constexpr int retireDelayMs = 5000;
+
+void retireBuild(std::shared_ptr<const void> build)
+{
+  if (!build)
+    return;
+
+  if (auto app = QCoreApplication::instance())
+    QTimer::singleShot(retireDelayMs, app, [build = std::move(build)] {});
+}
+}
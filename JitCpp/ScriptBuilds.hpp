@@ -0,0 +1,90 @@
+#pragma once
+#include <JitCpp/CompileScheduler.hpp>
+
+#include <QPointer>
+#include <QString>
+
+#include <score_addon_jit_export.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Jit
+{
+/**
+ * @brief Keeps a replaced build alive while the execution may still run
+ * its code.
+ *
+ * The nodes are handed the new functions through the execution queue: the
+ * previous build is released a few seconds later, and destroyed on the
+ * thread which built it, see makeDriver. GUI thread only.
+ */
+SCORE_ADDON_JIT_EXPORT
+void retireBuild(std::shared_ptr<const void> build);
+
+/**
+ * @brief The builds of a script process.
+ *
+ * Its jobs are keyed by the process, so that a new version of the script
+ * replaces the pending one, and are cancelled along with the process.
+ */
+template <typename Compiler_T>
+class ScriptBuilds
+{
+public:
+  ScriptBuilds(const char* kind, const void* owner)
+      : m_key{
+          std::string(kind) + "-"
+          + std::to_string(reinterpret_cast<std::intptr_t>(owner))}
+  {
+  }
+
+  //! The process can be removed while the execution runs its node
+  ~ScriptBuilds()
+  {
+    CompileScheduler::instance().cancel(m_key);
+    retireBuild(std::move(m_current));
+  }
+
+  ScriptBuilds(const ScriptBuilds&) = delete;
+  ScriptBuilds& operator=(const ScriptBuilds&) = delete;
+
+  //! Compiles synchronously, used when loading
+  void run(const CompileScheduler::Work& work) const
+  {
+    if (auto done = CompileScheduler::instance().runNow(work))
+      done();
+  }
+
+  //! Compiles in the background, the result is applied once ready
+  void submit(CompilePriority prio, CompileScheduler::Work work) const
+  {
+    CompileScheduler::instance().submit(m_key, prio, std::move(work));
+  }
+
+  //! The previous build is retired, see retireBuild
+  void setCurrent(std::shared_ptr<Compiler_T> compiler)
+  {
+    retireBuild(std::move(m_current));
+    m_current = std::move(compiler);
+  }
+
+  Compiler_T* current() const noexcept { return m_current.get(); }
+
+private:
+  std::string m_key;
+  std::shared_ptr<Compiler_T> m_current;
+};
+
+//! Completion of a failed build: reports err to the process, if it is
+//! still there
+template <typename Model_T>
+CompileScheduler::Completion reportError(QPointer<Model_T> self, QString err)
+{
+  return [self, err] {
+    if (self)
+      self->errorMessage(0, err);
+  };
+}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <Process/Dataflow/Port.hpp>
+#include <Process/Execution/ProcessComponent.hpp>
+
+#include <ossia/dataflow/graph_node.hpp>
+#include <ossia/dataflow/node_process.hpp>
+#include <ossia/dataflow/port.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace Jit
+{
+/**
+ * @brief Executor of a script process whose node is built by the addon
+ * around the JIT'd function.
+ *
+ * New ports need a new node: setNode swaps it in the running graph along
+ * with its cables, instead of leaving the graph with the previous one, and
+ * forwards the values of the control inlets of the process to it.
+ */
+template <typename Model_T>
+class ScriptExecutor
+    : public Execution::ProcessComponent_T<Model_T, ossia::node_process>
+{
+  using base_type = Execution::ProcessComponent_T<Model_T, ossia::node_process>;
+
+public:
+  using base_type::base_type;
+
+protected:
+  void setNode(std::shared_ptr<ossia::graph_node> n)
+  {
+    auto old = std::move(this->node);
+    this->node = std::move(n);
+
+    if (!old)
+    {
+      // Not in the graph yet
+      this->m_ossia_process
+          = std::make_shared<ossia::node_process>(this->node);
+    }
+    else
+    {
+      Execution::Transaction commands{this->system()};
+      commands.push_back([proc = this->m_ossia_process, node = this->node] {
+        proc->node = node;
+      });
+      this->nodeChanged(old, this->node, &commands);
+      commands.run_all();
+    }
+
+    connectControls();
+  }
+
+private:
+  void connectControls()
+  {
+    // The previous node and its ports are gone
+    for (auto& c : m_connections)
+      QObject::disconnect(c);
+    m_connections.clear();
+
+    auto& proc = this->process();
+    for (std::size_t i = 0; i < proc.inlets().size(); i++)
+    {
+      auto inlet = dynamic_cast<Process::ControlInlet*>(proc.inlets()[i]);
+      if (!inlet)
+        continue;
+
+      auto inl = this->node->root_inputs()[i];
+      inl->template target<ossia::value_port>()->write_value(inlet->value(), {});
+      m_connections.push_back(QObject::connect(
+          inlet,
+          &Process::ControlInlet::valueChanged,
+          this,
+          [this, inl](const ossia::value& v) {
+            this->system().executionQueue.enqueue([inl, val = v]() mutable {
+              inl->template target<ossia::value_port>()->write_value(
+                  std::move(val), 1);
+            });
+          }));
+    }
+  }
+
+  std::vector<QMetaObject::Connection> m_connections;
+};
+}
@@ -0,0 +1,137 @@
+#include <JitCpp/Telemetry.hpp>
+#include <JitCpp/CompileStats.hpp>
+#include <JitCpp/JitMemory.hpp>
+#include <JitCpp/Profiler.hpp>
+
+#include <ossia/network/base/name_validation.hpp>
+#include <ossia/network/base/node_functions.hpp>
+#include <ossia/network/base/parameter.hpp>
+#include <ossia/network/generic/generic_device.hpp>
+#include <ossia/network/oscquery/oscquery_server.hpp>
+
+#include <QDebug>
+
+#include <set>
+
+namespace Jit
+{
+Telemetry::Telemetry(int oscPort, int wsPort)
+    : m_device{std::make_unique<ossia::net::generic_device>(
+        std::make_unique<ossia::oscquery::oscquery_server_protocol>(
+            oscPort, wsPort),
+        "jit")}
+{
+  QObject::connect(&m_timer, &QTimer::timeout, [this] { update(); });
+  m_timer.start(500);
+  update();
+
+  qDebug() << "JIT telemetry published on OSCQuery port" << wsPort;
+}
+
+Telemetry::~Telemetry() = default;
+
+std::unique_ptr<Telemetry> Telemetry::fromEnvironment()
+{
+  if (!qEnvironmentVariableIsSet("SCORE_JIT_TELEMETRY"))
+    return {};
+
+  int osc = 4567, ws = 4568;
+  const auto ports = qEnvironmentVariable("SCORE_JIT_TELEMETRY").split(':');
+  if (ports.size() == 2)
+  {
+    osc = ports[0].toInt();
+    ws = ports[1].toInt();
+  }
+
+  try
+  {
+    return std::make_unique<Telemetry>(osc, ws);
+  }
+  catch (const std::exception& e)
+  {
+    qDebug() << "JIT telemetry disabled:" << e.what();
+    return {};
+  }
+}
+
+ossia::net::parameter_base&
+Telemetry::parameter(const std::string& path, bool integer)
+{
+  auto it = m_parameters.find(path);
+  if (it != m_parameters.end())
+    return *it->second;
+
+  auto& node = ossia::net::create_node(m_device->get_root_node(), path);
+  auto param = node.create_parameter(
+      integer ? ossia::val_type::INT : ossia::val_type::FLOAT);
+  param->set_access(ossia::access_mode::GET);
+  m_parameters.emplace(path, param);
+  return *param;
+}
+
+void Telemetry::update()
+{
+  auto& stats = CompileStatistics::instance();
+  parameter("/compile/last_ms", false)
+      .push_value(float(stats.lastBuildMilliseconds()));
+  parameter("/compile/count", true).push_value(int(stats.buildCount()));
+  parameter("/compile/rss_mb", false)
+      .push_value(float(residentMemory() / (1024. * 1024.)));
+
+  const auto hits = stats.cacheHits();
+  const auto misses = stats.cacheMisses();
+  parameter("/cache/hits", true).push_value(int(hits));
+  parameter("/cache/misses", true).push_value(int(misses));
+  parameter("/cache/hit_rate", false)
+      .push_value(hits + misses > 0 ? float(hits) / (hits + misses) : 0.f);
+
+  const auto mem = JitMemory::instance().total();
+  parameter("/memory/instances", true).push_value(mem.instances);
+  parameter("/memory/code_kb", false).push_value(float(mem.code / 1024.));
+  parameter("/memory/data_kb", false).push_value(float(mem.data / 1024.));
+  parameter("/memory/build_rss_kb", false)
+      .push_value(float(mem.rssDelta / 1024.));
+  parameter("/memory/arena_overflows", true).push_value(int(mem.arenaOverflows));
+
+  // Running processes; the names are made unique as several processes
+  // can share one.
+  std::set<std::string> names;
+  for (const auto& s : Profiler::instance().snapshots())
+  {
+    const auto base = ossia::net::sanitize_name(s.name.toStdString());
+    auto name = base;
+    for (int i = 2; names.count(name); i++)
+      name = base + "." + std::to_string(i);
+    names.insert(name);
+
+    const auto root = "/process/" + name;
+    parameter(root + "/cpu", false).push_value(float(100. * s.load));
+    parameter(root + "/avg_us", false).push_value(float(s.avgUs));
+    parameter(root + "/max_us", false).push_value(float(s.maxUs));
+    parameter(root + "/p99_us", false).push_value(float(s.p99Us));
+    parameter(root + "/overruns", true).push_value(int(s.overruns));
+  }
+
+  // Remove the processes which stopped
+  if (auto procs = ossia::net::find_node(m_device->get_root_node(), "/process"))
+  {
+    std::vector<std::string> stopped;
+    for (const auto& child : procs->children())
+      if (!names.count(child->get_name()))
+        stopped.push_back(child->get_name());
+
+    for (const auto& name : stopped)
+    {
+      const auto root = "/process/" + name + "/";
+      for (auto it = m_parameters.begin(); it != m_parameters.end();)
+      {
+        if (it->first.compare(0, root.size(), root) == 0)
+          it = m_parameters.erase(it);
+        else
+          ++it;
+      }
+      procs->remove_child(name);
+    }
+  }
+}
+}
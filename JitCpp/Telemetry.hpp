@@ -0,0 +1,44 @@
+#pragma once
+#include <QTimer>
+
+#include <memory>
+#include <unordered_map>
+
+namespace ossia::net
+{
+class generic_device;
+class parameter_base;
+}
+
+namespace Jit
+{
+/**
+ * @brief Publishes the JIT metrics on an OSCQuery device named "jit".
+ *
+ * Enabled with SCORE_JIT_TELEMETRY=<osc port>:<websocket port>
+ * (4567:4568 if only set). The tree is:
+ *
+ * - /compile/last_ms, /compile/count, /compile/rss_mb
+ * - /cache/hits, /cache/misses, /cache/hit_rate
+ * - /memory/instances, code_kb, data_kb, build_rss_kb, arena_overflows
+ * - /process/<name>/cpu, avg_us, max_us, p99_us, overruns
+ *   when profiling is enabled.
+ */
+class Telemetry
+{
+public:
+  Telemetry(int oscPort, int wsPort);
+  ~Telemetry();
+
+  //! Created from the environment, or nullptr if not enabled
+  static std::unique_ptr<Telemetry> fromEnvironment();
+
+private:
+  void update();
+  ossia::net::parameter_base& parameter(const std::string& path, bool integer);
+
+  std::unique_ptr<ossia::net::generic_device> m_device;
+  std::unordered_map<std::string, ossia::net::parameter_base*> m_parameters;
+  QTimer m_timer;
+};
+}
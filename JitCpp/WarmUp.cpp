@@ -0,0 +1,60 @@
+#include <JitCpp/WarmUp.hpp>
+
+#include <QtGlobal>
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Jit
+{
+static std::size_t pageSize() noexcept
+{
+#if defined(_WIN32)
+  SYSTEM_INFO info{};
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  return sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void prefault(void* ptr, std::size_t size, bool writable, bool lock) noexcept
+{
+  if (!ptr || size == 0)
+    return;
+
+  static const std::size_t page = pageSize();
+  auto begin = static_cast<volatile uint8_t*>(ptr);
+  auto end = begin + size;
+  for (auto p = begin; p < end; p += page)
+  {
+    // Writing back what was read makes the copy-on-write of zero pages
+    // happen now
+    const uint8_t v = *p;
+    if (writable)
+      *p = v;
+  }
+
+  if (lock)
+  {
+#if defined(_WIN32)
+    VirtualLock(ptr, size);
+#else
+    mlock(ptr, size);
+#endif
+  }
+}
+
+bool dryRunEnabled() noexcept
+{
+  static const bool enabled
+      = qEnvironmentVariable("SCORE_JIT_DRY_RUN", "1") != QLatin1String("0");
+  return enabled;
+}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <score_addon_jit_export.h>
+
+#include <cstddef>
+
+namespace Jit
+{
+/**
+ * @brief Faults the pages of a JIT'd section in before its code is used.
+ *
+ * Called once the objects are loaded, on the compile thread, so that the
+ * first run() on the audio thread does not take the page faults. Writable
+ * pages are written to, code pages are also locked in RAM when the
+ * system allows it (mlock / VirtualLock; failures are ignored).
+ */
+SCORE_ADDON_JIT_EXPORT
+void prefault(void* ptr, std::size_t size, bool writable, bool lock) noexcept;
+
+//! Whether new functions are run once on silence before being handed to
+//! the execution ; SCORE_JIT_DRY_RUN=0 disables it
+SCORE_ADDON_JIT_EXPORT
+bool dryRunEnabled() noexcept;
+}
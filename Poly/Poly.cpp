@@ -0,0 +1,598 @@
+#include "Poly.hpp"
+
+#include <QPointer>
+
+#include <JitCpp/Compiler/Driver.hpp>
+#include <JitCpp/EditScript.hpp>
+#include <JitCpp/ExecutionContext.hpp>
+#include <JitCpp/Profiler.hpp>
+#include <JitCpp/RealtimeArena.hpp>
+#include <JitCpp/SampleConversion.hpp>
+#include <JitCpp/WarmUp.hpp>
+
+#include <Process/Dataflow/Port.hpp>
+#include <Process/Dataflow/PortFactory.hpp>
+
+#include <score/command/Dispatchers/CommandDispatcher.hpp>
+#include <score/tools/IdentifierGeneration.hpp>
+
+#include <ossia/dataflow/execution_state.hpp>
+#include <ossia/dataflow/port.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include <wobjectimpl.h>
+
+W_OBJECT_IMPL(Jit::PolyModel)
+namespace Jit
+{
+/**
+ * @brief The script is one voice ; the kernel runs all of them per frame.
+ *
+ * SCORE_POLY_VOICE_STATE turns the fields of a voice into one array per
+ * field, and score_voice_state into a view of one lane of these arrays:
+ * once score_voice is inlined, the loop over the voices reads and writes
+ * contiguous memory and is vectorized with one voice per lane.
+ */
+QString generatePolyFunction(const QString& script)
+{
+  static const char prelude[] = R"_(
+#define SCORE_POLY_VOICES %1
+struct score_poly_notes
+{
+  float frequency[SCORE_POLY_VOICES];
+  float velocity[SCORE_POLY_VOICES];
+  float gate[SCORE_POLY_VOICES];
+  int trigger[SCORE_POLY_VOICES];
+};
+struct score_voice_note
+{
+  float frequency;
+  float velocity;
+  float gate;
+};
+#define SCORE_POLY_SOA_FIELD(x) float x[SCORE_POLY_VOICES];
+#define SCORE_POLY_LANE_FIELD(x) float& x;
+#define SCORE_POLY_BIND_FIELD(x) s.x[v],
+#define SCORE_POLY_RESET_FIELD(x) s.x[v] = 0.f;
+#define SCORE_POLY_VOICE_STATE(FIELDS) \
+  struct alignas(SCORE_BLOCK_ALIGNMENT) score_poly_state \
+  { FIELDS(SCORE_POLY_SOA_FIELD) }; \
+  struct score_voice_state \
+  { FIELDS(SCORE_POLY_LANE_FIELD) }; \
+  static inline score_voice_state score_voice_lane(score_poly_state& s, int v) \
+  { return {FIELDS(SCORE_POLY_BIND_FIELD)}; } \
+  static inline void score_voice_reset(score_poly_state& s, int v) \
+  { FIELDS(SCORE_POLY_RESET_FIELD) } \
+  extern "C" const int score_poly_state_size = sizeof(score_poly_state)
+#line 1
+)_";
+
+  static const char kernel[] = R"_(
+extern "C" void score_poly_process(
+    float* __restrict out, int frames, void* __restrict state,
+    const score_poly_notes* __restrict notes, const score_block_params* p)
+{
+  auto& s = *static_cast<score_poly_state*>(state);
+  for(int v = 0; v < SCORE_POLY_VOICES; v++)
+    if(notes->trigger[v])
+      score_voice_reset(s, v);
+
+  for(int f = 0; f < frames; f++)
+  {
+    float mix = 0.f;
+#pragma clang loop vectorize(enable)
+    for(int v = 0; v < SCORE_POLY_VOICES; v++)
+    {
+      auto voice = score_voice_lane(s, v);
+      const score_voice_note note{
+          notes->frequency[v], notes->velocity[v], notes->gate[v]};
+      mix += score_voice(voice, note, p);
+    }
+    out[f] = mix;
+  }
+}
+)_";
+
+  return blockPrelude() + QString(prelude).arg(polyVoices) + script + "\n"
+         + kernel;
+}
+
+PolyModel::PolyModel(
+    TimeVal t,
+    const QString& jitProgram,
+    const Id<Process::ProcessModel>& id,
+    QObject* parent)
+    : Process::ProcessModel{t, id, "Jit", parent}
+{
+  auto midi_in = new Process::MidiInlet{Id<Process::Port>{0}, this};
+  this->m_inlets.push_back(midi_in);
+  updateControlInlets(*this, m_inlets, m_controls, defaultBlockControls());
+
+  auto audio_out = new Process::AudioOutlet{Id<Process::Port>{0}, this};
+  audio_out->setPropagate(true);
+  this->m_outlets.push_back(audio_out);
+  init();
+  if(jitProgram.isEmpty())
+    setScript(Process::EffectProcessFactory_T<Jit::PolyModel>{}.customConstructionData());
+  else
+    setScript(jitProgram);
+}
+
+PolyModel::~PolyModel() {}
+
+PolyModel::PolyModel(JSONObject::Deserializer& vis, QObject* parent)
+    : Process::ProcessModel{vis, parent}
+{
+  vis.writeTo(*this);
+  init();
+}
+
+PolyModel::PolyModel(DataStream::Deserializer& vis, QObject* parent)
+    : Process::ProcessModel{vis, parent}
+{
+  vis.writeTo(*this);
+  init();
+}
+
+PolyModel::PolyModel(JSONObject::Deserializer&& vis, QObject* parent)
+    : Process::ProcessModel{vis, parent}
+{
+  vis.writeTo(*this);
+  init();
+}
+
+PolyModel::PolyModel(DataStream::Deserializer&& vis, QObject* parent)
+    : Process::ProcessModel{vis, parent}
+{
+  vis.writeTo(*this);
+  init();
+}
+
+void PolyModel::setScript(const QString& txt)
+{
+  if(m_text != txt)
+  {
+    m_text = txt;
+    reloadAsync(CompilePriority::Editor);
+    scriptChanged(txt);
+  }
+}
+
+void PolyModel::init()
+{
+  // Recompile for the new buffer size and sample rate
+  ExecutionContext::onChanged(
+      this, [this] { reloadAsync(CompilePriority::Playing); });
+}
+
+QString PolyModel::prettyName() const noexcept
+{
+  return "Poly";
+}
+
+void PolyModel::reload()
+{
+  m_builds.run(compileJob());
+}
+
+void PolyModel::reloadAsync(CompilePriority prio)
+{
+  m_builds.submit(prio, compileJob());
+}
+
+/**
+ * @brief Voice state given to a poly function.
+ *
+ * Aligned on blockAlignment bytes like the arrays of score_poly_state, and
+ * zeroed: voices which never played are silent.
+ */
+class poly_state
+{
+public:
+  explicit poly_state(int bytes)
+      : m_storage(bytes + blockAlignment)
+  {
+    void* base = m_storage.data();
+    std::size_t space = m_storage.size();
+    m_data = std::align(blockAlignment, bytes, base, space);
+  }
+
+  void* data() const noexcept { return m_data; }
+
+private:
+  std::vector<unsigned char> m_storage;
+  void* m_data{};
+};
+
+//! Runs a new poly function once, without any note, on the compile thread
+static void dryRun(
+    PolyFunction* fun,
+    int stateSize,
+    const std::vector<BlockControl>& decls,
+    const ExecutionContext& context)
+{
+  std::vector<float> out(context.bufferSize);
+  poly_state state{stateSize};
+  const PolyNotes notes{};
+  const block_controls controls{decls};
+  const auto params = controls.params(context.sampleRate, 0);
+  fun(out.data(), context.bufferSize, state.data(), &notes, &params);
+}
+
+CompileScheduler::Work PolyModel::compileJob()
+{
+  auto fx_text = Jit::generatePolyFunction(m_text).toLocal8Bit().toStdString();
+  QPointer<PolyModel> self = this;
+  const void* owner = this;
+  auto name = metadata().getName();
+  auto context = ExecutionContext::current();
+  auto flags = context.flags();
+  return [self, owner, name, fx_text, flags, context](
+             const CancellationToken& cancelled)
+             -> CompileScheduler::Completion {
+    if (fx_text.empty())
+      return {};
+
+    auto compiler = makeDriver<PolyCompiler>(
+        "score_poly_process", name, owner, RealtimeArena::defaultSize());
+    PolyFactory jit_factory;
+    int stateSize{};
+    std::vector<BlockControl> controls;
+    CompilerOptions opts{true};
+    opts.OptimizationRemarks = true;
+
+    try
+    {
+      jit_factory = (*compiler)(fx_text, flags, opts, cancelled);
+
+      if (!jit_factory)
+        return {};
+
+      auto size = compiler->symbol<const int>("score_poly_state_size");
+      if (!size)
+      {
+        return reportError(self, "The voice has no SCORE_POLY_VOICE_STATE");
+      }
+      stateSize = *size;
+
+      auto declared = declaredControls(
+          compiler->symbol<const int>("score_block_control_count"),
+          compiler->symbol<const BlockControlDeclaration>(
+              "score_block_controls"));
+      if (!declared)
+      {
+        return reportError(self, "Unknown control type");
+      }
+      controls = std::move(*declared);
+
+      if (dryRunEnabled())
+      {
+        ScopedArena arena{compiler->arena()};
+        if (auto f = jit_factory.target<PolyFunction*>())
+          dryRun(*f, stateSize, controls, context);
+      }
+    }
+    catch (const std::exception& e)
+    {
+      return reportError(self, QString{e.what()});
+    }
+    catch (...)
+    {
+      return reportError(self, "JIT error");
+    }
+
+    auto remarks = remarksMessage(compiler->remarks());
+    return [self, compiler, jit_factory, stateSize, controls, remarks] {
+      if (self)
+      {
+        self->setFactory(compiler, jit_factory, stateSize, controls);
+        if (!remarks.second.empty())
+          self->errorMessage(
+              remarks.first, QString::fromStdString(remarks.second));
+      }
+    };
+  };
+}
+
+void PolyModel::setFactory(
+    std::shared_ptr<PolyCompiler> compiler,
+    PolyFactory jit_factory,
+    int stateSize,
+    std::vector<BlockControl> controls)
+{
+  m_builds.setCurrent(std::move(compiler));
+
+  factory = std::move(jit_factory);
+  this->stateSize = stateSize;
+  arena = m_builds.current()->arena();
+  if (updateControlInlets(*this, m_inlets, m_controls, std::move(controls)))
+    inletsChanged();
+  changed();
+}
+
+/**
+ * @brief Allocates the voices from the MIDI inlet and runs the poly function.
+ *
+ * The buffer is split at each note so that they start on time. A key
+ * pressed again gets its voice back ; otherwise the voice released the
+ * longest ago is used, and when all of them are held the oldest one.
+ */
+class poly_node final
+    : public ossia::nonowning_graph_node
+{
+public:
+  poly_node(const std::vector<BlockControl>& decls, int bufferSize, int stateSize)
+      : controls{decls}
+      , state{stateSize}
+  {
+    m_inlets.push_back(&midi_in);
+    for (auto& port : controls.ports())
+      m_inlets.push_back(&port);
+    m_outlets.push_back(&audio_out);
+
+    samples.reserve(bufferSize);
+    std::fill(std::begin(keys), std::end(keys), -1);
+  }
+
+  void set_function(PolyFunction* func, RealtimeArena* arena)
+  {
+    this->func = func;
+    this->arena = arena;
+  }
+
+  void run(const ossia::token_request& t, ossia::exec_state_facade f) noexcept override
+  {
+    controls.update();
+
+    const int N = f.bufferSize();
+    samples.resize(N);
+
+    auto params = controls.params(f.sampleRate(), time);
+    {
+      Jit::ScopedProfile p{profile.get(), N, f.sampleRate()};
+      Jit::ScopedArena a{arena};
+
+      int pos = 0;
+      for (const auto& m : midi_in->messages)
+      {
+        const int ts = std::clamp(int(m.timestamp), pos, N);
+        render(pos, ts, params);
+        pos = ts;
+        apply(m.bytes);
+      }
+      render(pos, N, params);
+    }
+    time += N;
+
+    ossia::audio_port& o = *audio_out;
+    o.samples.resize(2);
+    o.samples[0].resize(N);
+    convertSamples(samples.data(), o.samples[0].data(), N);
+    o.samples[1] = o.samples[0];
+  }
+
+  long long time = 0;
+  PolyFunction* func = nullptr;
+  RealtimeArena* arena = nullptr;
+  std::shared_ptr<Jit::NodeProfile> profile;
+
+  ossia::midi_inlet midi_in;
+  block_controls controls;
+  ossia::audio_outlet audio_out;
+
+private:
+  void render(int from, int to, BlockParams& params) noexcept
+  {
+    if (to <= from)
+      return;
+
+    if (func)
+    {
+      params.time = time + from;
+      func(samples.data() + from, to - from, state.data(), &notes, &params);
+      std::fill(std::begin(notes.trigger), std::end(notes.trigger), 0);
+    }
+    else
+    {
+      std::fill(samples.begin() + from, samples.begin() + to, 0.f);
+    }
+  }
+
+  template <typename Bytes>
+  void apply(const Bytes& bytes) noexcept
+  {
+    if (bytes.size() < 3)
+      return;
+
+    const int status = bytes[0] & 0xF0;
+    const int key = bytes[1];
+    const int velocity = bytes[2];
+    if (status == 0x90 && velocity > 0)
+      noteOn(key, velocity);
+    else if (status == 0x80 || status == 0x90)
+      noteOff(key);
+  }
+
+  void noteOn(int key, int velocity) noexcept
+  {
+    int v = -1;
+    for (int i = 0; i < polyVoices && v < 0; i++)
+      if (keys[i] == key && notes.gate[i] > 0.f)
+        v = i;
+
+    for (int released = 1; released >= 0 && v < 0; released--)
+    {
+      for (int i = 0; i < polyVoices; i++)
+      {
+        if (released && notes.gate[i] > 0.f)
+          continue;
+        if (v < 0 || ages[i] < ages[v])
+          v = i;
+      }
+    }
+
+    keys[v] = key;
+    ages[v] = ++clock;
+    notes.frequency[v] = 440.f * std::exp2((key - 69) / 12.f);
+    notes.velocity[v] = velocity / 127.f;
+    notes.gate[v] = 1.f;
+    notes.trigger[v] = 1;
+  }
+
+  void noteOff(int key) noexcept
+  {
+    for (int i = 0; i < polyVoices; i++)
+    {
+      if (keys[i] == key && notes.gate[i] > 0.f)
+      {
+        notes.gate[i] = 0.f;
+        ages[i] = ++clock;
+      }
+    }
+  }
+
+  poly_state state;
+  PolyNotes notes{};
+  int keys[polyVoices];
+  int64_t ages[polyVoices]{};
+  int64_t clock{};
+  std::vector<float> samples;
+};
+
+static PolyFunction* polyFunction(const PolyFactory& f)
+{
+  auto tgt = f.target<PolyFunction*>();
+  return tgt ? *tgt : nullptr;
+}
+
+PolyExecutor::PolyExecutor(
+    Jit::PolyModel& proc,
+    const Execution::Context& ctx,
+    const Id<score::Component>& id,
+    QObject* parent)
+    : ScriptExecutor{proc, ctx, id, "JitComponent", parent}
+{
+  reset();
+
+  con(proc, &Jit::PolyModel::changed,
+      this, [this, &proc] {
+        // New controls or another voice state need a new node
+        if (proc.controls() != m_controls || proc.stateSize != m_stateSize)
+        {
+          reset();
+          return;
+        }
+
+        auto bb = static_cast<poly_node*>(node.get());
+        if(auto f = polyFunction(proc.factory))
+        {
+          in_exec([f, bb, arena = proc.arena] {
+            bb->set_function(f, arena);
+          });
+        }
+  });
+}
+
+void PolyExecutor::reset()
+{
+  auto& proc = process();
+  m_controls = proc.controls();
+  m_stateSize = proc.stateSize;
+
+  auto bb = new poly_node{
+      m_controls, ExecutionContext::current().bufferSize, m_stateSize};
+  bb->profile = Jit::Profiler::instance().create(&proc, proc.metadata().getName());
+  bb->set_function(polyFunction(proc.factory), proc.arena);
+  setNode(std::shared_ptr<ossia::graph_node>(bb));
+}
+
+PolyExecutor::~PolyExecutor() {}
+
+}
+
+template <>
+void DataStreamReader::read(const Jit::PolyModel& eff)
+{
+  m_stream << eff.m_text;
+  readPorts(*this, eff.m_inlets, eff.m_outlets);
+}
+
+template <>
+void DataStreamWriter::write(Jit::PolyModel& eff)
+{
+  m_stream >> eff.m_text;
+  writePorts(
+      *this,
+      components.interfaces<Process::PortFactoryList>(),
+      eff.m_inlets,
+      eff.m_outlets,
+      &eff);
+  eff.reload();
+}
+
+template <>
+void JSONReader::read(const Jit::PolyModel& eff)
+{
+  obj["Text"] = eff.script();
+  readPorts(*this, eff.m_inlets, eff.m_outlets);
+}
+
+template <>
+void JSONWriter::write(Jit::PolyModel& eff)
+{
+  eff.m_text = obj["Text"].toString();
+  writePorts(
+      *this,
+      components.interfaces<Process::PortFactoryList>(),
+      eff.m_inlets,
+      eff.m_outlets,
+      &eff);
+  eff.reload();
+}
+
+namespace Process
+{
+
+template <>
+QString
+EffectProcessFactory_T<Jit::PolyModel>::customConstructionData() const
+{
+  return R"_(#include <math.h>
+
+// The state of one voice ; each field is stored as one array across the
+// voices, which run side by side in SIMD lanes
+#define VOICE(F) F(phase) F(env)
+SCORE_POLY_VOICE_STATE(VOICE);
+
+SCORE_BLOCK_CONTROLS(
+  {"Attack", SCORE_CONTROL_FLOAT, 0.001f, 1.f, 0.01f},
+  {"Release", SCORE_CONTROL_FLOAT, 0.001f, 4.f, 0.3f},
+  {"Volume", SCORE_CONTROL_FLOAT, 0.f, 1.f, 0.2f}
+);
+
+// Called for each voice and each frame ; branches are better written as
+// selects so that the voices stay in lockstep
+static inline float score_voice(
+    score_voice_state& v, const score_voice_note& n, const score_block_params* p)
+{
+  const float dt = 1.f / float(p->sample_rate);
+  const float time = n.gate > 0.f ? p->controls[0] : p->controls[1];
+  v.env += (n.gate * n.velocity - v.env) * fminf(1.f, dt / time);
+  v.phase += n.frequency * dt;
+  v.phase -= floorf(v.phase);
+  return p->controls[2] * v.env * sinf(6.2831853f * v.phase);
+}
+)_";
+}
+
+template <>
+Process::Descriptor
+EffectProcessFactory_T<Jit::PolyModel>::descriptor(QString d) const
+{
+  return Metadata<Descriptor_k, Jit::PolyModel>::get();
+}
+
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <Process/Execution/ProcessComponent.hpp>
+#include <Process/GenericProcessFactory.hpp>
+#include <Process/Process.hpp>
+#include <Process/ProcessMetadata.hpp>
+
+#include <ossia/dataflow/execution_state.hpp>
+#include <ossia/dataflow/graph_node.hpp>
+#include <ossia/dataflow/node_process.hpp>
+
+#include <Process/Script/ScriptEditor.hpp>
+#include <Block/BlockControls.hpp>
+#include <JitCpp/EditScript.hpp>
+#include <JitCpp/CompileScheduler.hpp>
+#include <JitCpp/ScriptBuilds.hpp>
+#include <JitCpp/ScriptExecutor.hpp>
+
+#include <Control/DefaultEffectItem.hpp>
+#include <Effect/EffectFactory.hpp>
+#include <verdigris>
+
+namespace Jit
+{
+class PolyModel;
+}
+PROCESS_METADATA(
+    ,
+    Jit::PolyModel,
+    "68629e9b-a698-458f-b9b6-f0949639aca6",
+    "Jit",
+    "C++ polyphonic synth",
+    Process::ProcessCategory::Script,
+    "Script",
+    "Run one C++ voice on several notes at once, in SIMD lanes",
+    "ossia score",
+    QStringList{},
+    {},
+    {},
+    Process::ProcessFlags::SupportsAll)
+namespace Jit
+{
+template <typename Fun_T>
+struct Driver;
+class RealtimeArena;
+
+//! Voices computed together by a poly function, one per SIMD lane
+static constexpr int polyVoices = 16;
+
+/**
+ * @brief The notes played by the voices, one lane per voice.
+ *
+ * Has to stay identical to the struct given to the scripts. Written by the
+ * node as MIDI comes in: gate is 1 while the key is held, trigger asks the
+ * function to reset the state of the voice before running it.
+ */
+struct PolyNotes
+{
+  float frequency[polyVoices];
+  float velocity[polyVoices];
+  float gate[polyVoices];
+  int trigger[polyVoices];
+};
+
+/**
+ * @brief Plain C entry point of a poly process.
+ *
+ * Generated around the score_voice function of the script, see
+ * generatePolyFunction: state is the structure-of-arrays declared with
+ * SCORE_POLY_VOICE_STATE, allocated by the node and zeroed when a voice is
+ * triggered. The voices are mixed in a mono output.
+ */
+using PolyFunction = void(
+    float* out,
+    int frames,
+    void* state,
+    const PolyNotes* notes,
+    const BlockParams* params);
+using PolyCompiler = Driver<PolyFunction>;
+using PolyFactory = std::function<PolyFunction>;
+
+class PolyModel : public Process::ProcessModel
+{
+  friend class JitUI;
+  friend class JitUpdateUI;
+  SCORE_SERIALIZE_FRIENDS
+  PROCESS_METADATA_IMPL(PolyModel)
+
+  W_OBJECT(PolyModel)
+public:
+  PolyModel(
+      TimeVal t,
+      const QString& jitProgram,
+      const Id<Process::ProcessModel>&,
+      QObject* parent);
+  ~PolyModel() override;
+
+  PolyModel(DataStream::Deserializer& vis, QObject* parent);
+  PolyModel(JSONObject::Deserializer& vis, QObject* parent);
+  PolyModel(DataStream::Deserializer&& vis, QObject* parent);
+  PolyModel(JSONObject::Deserializer&& vis, QObject* parent);
+
+  const QString& script() const noexcept { return m_text; }
+  void setScript(const QString& txt);
+  void scriptChanged(const QString& txt) W_SIGNAL(scriptChanged, txt);
+
+  static constexpr bool hasExternalUI() noexcept { return true; }
+
+  QString prettyName() const noexcept override;
+  void changed() W_SIGNAL(changed);
+
+  Process::Inlets& inlets() { return m_inlets; }
+  Process::Outlets& outlets() { return m_outlets; }
+
+  //! Declared by the script with SCORE_BLOCK_CONTROLS, after the MIDI inlet
+  const std::vector<BlockControl>& controls() const noexcept
+  {
+    return m_controls;
+  }
+
+  PolyFactory factory;
+
+  //! Size of the voice state of factory, in bytes
+  int stateSize{};
+
+  //! Where the allocations of factory go, may be nullptr
+  RealtimeArena* arena{};
+
+  void errorMessage(int line, const QString& e) W_SIGNAL(errorMessage, line, e);
+
+  PROPERTY(QString, script READ script WRITE setScript NOTIFY scriptChanged)
+private:
+  void init();
+
+  //! Compiles synchronously, used when loading
+  void reload();
+
+  //! Compiles in the background, the result is applied once ready
+  void reloadAsync(CompilePriority prio);
+  CompileScheduler::Work compileJob();
+  void setFactory(
+      std::shared_ptr<PolyCompiler> compiler,
+      PolyFactory factory,
+      int stateSize,
+      std::vector<BlockControl> controls);
+
+  QString m_text;
+  std::vector<BlockControl> m_controls;
+  ScriptBuilds<PolyCompiler> m_builds{"poly", this};
+};
+}
+
+namespace Process
+{
+template <>
+QString
+EffectProcessFactory_T<Jit::PolyModel>::customConstructionData() const;
+
+template <>
+Process::Descriptor
+EffectProcessFactory_T<Jit::PolyModel>::descriptor(QString d) const;
+}
+class QPlainTextEdit;
+namespace Jit
+{
+
+struct PolyLanguageSpec
+{
+  static constexpr const char* language = "C++";
+};
+
+using PolyEffectFactory = Process::EffectProcessFactory_T<PolyModel>;
+using PolyLayerFactory = Process::EffectLayerFactory_T<
+    PolyModel,
+    Process::DefaultEffectItem,
+    Process::ProcessScriptEditDialog<PolyModel, PolyModel::p_script, PolyLanguageSpec>
+>;
+
+class PolyExecutor final : public ScriptExecutor<Jit::PolyModel>
+{
+  COMPONENT_METADATA("0c5d8f1c-257a-4655-bc36-aa70aa1ae68d")
+
+public:
+  static constexpr bool is_unique = true;
+
+  PolyExecutor(
+      Jit::PolyModel& proc,
+      const Execution::Context& ctx,
+      const Id<score::Component>& id,
+      QObject* parent);
+  ~PolyExecutor() override;
+
+private:
+  void reset();
+
+  std::vector<BlockControl> m_controls;
+  int m_stateSize{};
+};
+using PolyExecutorFactory
+    = Execution::ProcessComponentFactory_T<PolyExecutor>;
+}
+
+PROPERTY_COMMAND_T(Jit, EditPoly, PolyModel::p_script, "Edit polyphonic synth")
+SCORE_COMMAND_DECL_T(Jit::EditPoly)
@@ -4,6 +4,7 @@
 #include <QDialog>
 #include <QDialogButtonBox>
 #include <QPlainTextEdit>
+#include <QPointer>
 #include <QPushButton>
 #include <QSyntaxStyle>
 #include <QVBoxLayout>
@@ -83,7 +84,7 @@ void TexgenModel::setScript(const QString& txt)
   if(m_text != txt)
   {
     m_text = txt;
-    reload();
+    reloadAsync(CompilePriority::Editor);
     scriptChanged(txt);
   }
 }
@@ -103,39 +104,65 @@ bool TexgenModel::validate(const QString& txt) const noexcept
 
 void TexgenModel::reload()
 {
-  // FIXME dispos of them once unused at execution
-  static std::list<std::shared_ptr<TexgenCompiler>> old_compilers;
-  if (m_compiler)
-  {
-    old_compilers.push_front(std::move(m_compiler));
-    if (old_compilers.size() > 5)
-      old_compilers.pop_back();
-  }
+  m_builds.run(compileJob());
+}
 
-  m_compiler = std::make_unique<TexgenCompiler>("score_rgba");
-  auto fx_text = m_text.toLocal8Bit();
-  TexgenFactory jit_factory;
-  if (fx_text.isEmpty())
-    return;
+void TexgenModel::reloadAsync(CompilePriority prio)
+{
+  m_builds.submit(prio, compileJob());
+}
 
-  try
-  {
-    jit_factory = (*m_compiler)(fx_text.toStdString(), {}, CompilerOptions{true});
-    assert(jit_factory);
+CompileScheduler::Work TexgenModel::compileJob()
+{
+  auto fx_text = m_text.toLocal8Bit().toStdString();
+  QPointer<TexgenModel> self = this;
+  const void* owner = this;
+  auto name = metadata().getName();
+  return [self, owner, name, fx_text](const CancellationToken& cancelled)
+             -> CompileScheduler::Completion {
+    if (fx_text.empty())
+      return {};
+
+    auto compiler = makeDriver<TexgenCompiler>("score_rgba", name, owner);
+    TexgenFactory jit_factory;
+    CompilerOptions opts{true};
+    opts.OptimizationRemarks = true;
+
+    try
+    {
+      jit_factory = (*compiler)(fx_text, {}, opts, cancelled);
+      assert(jit_factory);
 
-    if (!jit_factory)
-      return;
-  }
-  catch (const std::exception& e)
-  {
-    errorMessage(0, e.what());
-    return;
-  }
-  catch (...)
-  {
-    errorMessage(0, "JIT error");
-    return;
-  }
+      if (!jit_factory)
+        return {};
+    }
+    catch (const std::exception& e)
+    {
+      return reportError(self, QString{e.what()});
+    }
+    catch (...)
+    {
+      return reportError(self, "JIT error");
+    }
+
+    auto remarks = remarksMessage(compiler->remarks());
+    return [self, compiler, jit_factory, remarks] {
+      if (self)
+      {
+        self->setFactory(compiler, jit_factory);
+        if (!remarks.second.empty())
+          self->errorMessage(
+              remarks.first, QString::fromStdString(remarks.second));
+      }
+    };
+  };
+}
+
+void TexgenModel::setFactory(
+    std::shared_ptr<TexgenCompiler> compiler,
+    TexgenFactory jit_factory)
+{
+  m_builds.setCurrent(std::move(compiler));
 
   factory = std::move(jit_factory);
   changed();
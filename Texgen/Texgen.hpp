@@ -12,6 +12,8 @@
 
 #include <Process/Script/ScriptEditor.hpp>
 #include <JitCpp/EditScript.hpp>
+#include <JitCpp/CompileScheduler.hpp>
+#include <JitCpp/ScriptBuilds.hpp>
 
 #include <Control/DefaultEffectItem.hpp>
 #include <Effect/EffectFactory.hpp>
@@ -83,9 +85,17 @@ public:
   PROPERTY(QString, script READ script WRITE setScript NOTIFY scriptChanged)
 private:
   void init();
+
+  //! Compiles synchronously, used when loading
   void reload();
+
+  //! Compiles in the background, the result is applied once ready
+  void reloadAsync(CompilePriority prio);
+  CompileScheduler::Work compileJob();
+  void setFactory(std::shared_ptr<TexgenCompiler> compiler, TexgenFactory factory);
+
   QString m_text;
-  std::unique_ptr<TexgenCompiler> m_compiler;
+  ScriptBuilds<TexgenCompiler> m_builds{"texgen", this};
 };
 }
 
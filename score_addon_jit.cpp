@@ -6,9 +6,16 @@
 
 #include <score/plugins/FactorySetup.hpp>
 
+#include <Inspector/InspectorWidgetFactoryInterface.hpp>
+
 #include <JitCpp/ApplicationPlugin.hpp>
+#include <JitCpp/CompileServer.hpp>
+#include <JitCpp/CompileWorker.hpp>
 #include <JitCpp/JitModel.hpp>
+#include <JitCpp/ProfilerInspector.hpp>
+#include <Block/Block.hpp>
 #include <Bytebeat/Bytebeat.hpp>
+#include <Poly/Poly.hpp>
 #include <Texgen/Texgen.hpp>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Support/ManagedStatic.h>
@@ -27,6 +34,15 @@ score_addon_jit::score_addon_jit()
   InitializeNativeTarget();
   InitializeNativeTargetAsmPrinter();
   InitializeNativeTargetAsmParser();
+
+  // score was started by CompileWorkerPool: serve compile requests
+  // and quit before the rest of the application starts.
+  if (Jit::isCompileWorker())
+    std::exit(Jit::runCompileWorker());
+
+  // score was started as the machine-local compile server
+  if (Jit::isCompileServer())
+    std::exit(Jit::runCompileServer());
 }
 
 score_addon_jit::~score_addon_jit() {}
@@ -40,6 +56,8 @@ std::vector<std::unique_ptr<score::InterfaceBase>> score_addon_jit::factories(
       FW<Process::ProcessModelFactory
       , Jit::JitEffectFactory
       , Jit::BytebeatEffectFactory
+      , Jit::BlockEffectFactory
+      , Jit::PolyEffectFactory
     #if defined(SCORE_JIT_HAS_TEXGEN)
       , Jit::TexgenEffectFactory
     #endif
@@ -47,6 +65,8 @@ std::vector<std::unique_ptr<score::InterfaceBase>> score_addon_jit::factories(
       FW<Process::LayerFactory
       , Jit::LayerFactory
       , Jit::BytebeatLayerFactory
+      , Jit::BlockLayerFactory
+      , Jit::PolyLayerFactory
     #if defined(SCORE_JIT_HAS_TEXGEN)
       , Jit::TexgenLayerFactory
     #endif
@@ -54,9 +74,17 @@ std::vector<std::unique_ptr<score::InterfaceBase>> score_addon_jit::factories(
       FW<Execution::ProcessComponentFactory
       , Execution::JitEffectComponentFactory
       , Jit::BytebeatExecutorFactory
+      , Jit::BlockExecutorFactory
+      , Jit::PolyExecutorFactory
     #if defined(SCORE_JIT_HAS_TEXGEN)
       , Jit::TexgenExecutorFactory
     #endif
+      >,
+      FW<Inspector::InspectorWidgetFactory
+      , Jit::JitProfilerInspectorFactory
+      , Jit::BytebeatProfilerInspectorFactory
+      , Jit::BlockProfilerInspectorFactory
+      , Jit::PolyProfilerInspectorFactory
       >
       >(ctx, key);
 }